@@ -2,4 +2,7 @@
 
 #include "AutomatronModule.h"
 
+#define AUTOMATRON_IMPLEMENTATION
+#include "Automatron.h"
+
 IMPLEMENT_MODULE(FAutomatronModule, Automatron)
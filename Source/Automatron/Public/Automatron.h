@@ -1,7 +1,8 @@
 // AUTOMATRON
 // Version: 1.2
 // Repository: https://github.com/splash-damage/automatron
-// Can be used as a header-only library or implemented as a module
+// Can be used as a header-only library or implemented as a module. Either way, one source file defines
+// AUTOMATRON_IMPLEMENTATION before including it, like AutomatronModule.cpp does
 
 // BSD 3-Clause License
 //
@@ -38,12 +39,29 @@
 #pragma once
 
 #include <CoreMinimal.h>
+#include <Containers/Queue.h>
 #include <Engine/Engine.h>
 #include <Engine/GameInstance.h>
 #include <EngineUtils.h>
 #include <GameFramework/GameModeBase.h>
 #include <GameMapsSettings.h>
+#include <Async/Async.h>
+#include <Async/MappedFileHandle.h>
+#include <Async/ParallelFor.h>
+#include <HAL/FileManager.h>
+#include <HAL/PlatformFileManager.h>
 #include <Misc/AutomationTest.h>
+#include <Misc/CoreDelegates.h>
+#include <Misc/FileHelper.h>
+#include <Misc/MemStack.h>
+#include <Misc/Paths.h>
+#include <Misc/QueuedThreadPool.h>
+#include <Misc/StringBuilder.h>
+#include <Modules/ModuleManager.h>
+#include <Serialization/BufferReader.h>
+#include <Serialization/MemoryWriter.h>
+#include <Serialization/ObjectReader.h>
+#include <Serialization/ObjectWriter.h>
 #include <Tests/AutomationCommon.h>
 
 
@@ -52,12 +70,83 @@
 #	include <Tests/AutomationEditorPromotionCommon.h>
 #endif
 
+
+// Exported by the Automatron module. Header-only users compile it into their own module
+#if !defined(AUTOMATRON_API)
+#	define AUTOMATRON_API
+#endif
+
+AUTOMATRON_API DECLARE_LOG_CATEGORY_EXTERN(LogAutomatron, Log, All);
+
+// Blocks capture their source location at compile time when the compiler provides the builtins.
+// Otherwise, tests report the file and line of their spec
+#if !defined(AUTOMATRON_HAS_SOURCE_LOCATION)
+#	if defined(__has_builtin)
+#		if __has_builtin(__builtin_FILE) && __has_builtin(__builtin_LINE)
+#			define AUTOMATRON_HAS_SOURCE_LOCATION 1
+#		endif
+#	elif defined(_MSC_VER) && _MSC_VER >= 1926
+#		define AUTOMATRON_HAS_SOURCE_LOCATION 1
+#	elif defined(__GNUC__)
+#		define AUTOMATRON_HAS_SOURCE_LOCATION 1
+#	endif
+#endif
+#if !defined(AUTOMATRON_HAS_SOURCE_LOCATION)
+#	define AUTOMATRON_HAS_SOURCE_LOCATION 0
+#endif
+
+// Specs are registered through a lightweight entry and only constructed when their tests are listed or run.
+// Define as 0 to construct every spec when specs get registered
+#if !defined(AUTOMATRON_LAZY_SPECS)
+#	define AUTOMATRON_LAZY_SPECS 1
+#endif
+
+// Lazy specs with bCanCacheTests list their tests from a manifest the editor saves in the intermediate dir.
+// The tests of a spec are listed again when it is compiled. Define as 0 to always define specs to list them
+#if !defined(AUTOMATRON_TEST_MANIFEST)
+#	define AUTOMATRON_TEST_MANIFEST 1
+#endif
+
+// Module the specs of a translation unit are compiled into. Specs without one are not saved to the manifest
+#if defined(UE_MODULE_NAME)
+#	define AUTOMATRON_MODULE_NAME UE_MODULE_NAME
+#else
+#	define AUTOMATRON_MODULE_NAME nullptr
+#endif
+
+// Coroutine blocks (CoIt, CoBeforeEach and CoAfterEach) are available to specs deriving from TCoroutineSpec
+// when compiling as C++20
+#if !defined(AUTOMATRON_COROUTINES)
+#	if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#		define AUTOMATRON_COROUTINES 1
+#	else
+#		define AUTOMATRON_COROUTINES 0
+#	endif
+#endif
+
+#if AUTOMATRON_COROUTINES
+#	include <coroutine>
+#endif
+
 ////////////////////////////////////////////////////////////////
 // DEFINITIONS
 
 namespace Automatron
 {
 	class FTestSpecBase;
+	class FTestSpec;
+
+	template <typename TParent>
+	class TCoroutineSpec;
+
+	// What systems a test world is created with
+	enum class ETestWorldProfile : uint8
+	{
+		// Everything a standalone game world has
+		Full,
+		// No game instance, rendering scene, physics, navigation, AI, audio or FX. For gameplay logic tests
+		LogicOnly
+	};
 
 	struct FTestWorldSettings
 	{
@@ -65,10 +154,167 @@ namespace Automatron
 		TSubclassOf<AGameModeBase> GameMode = AGameModeBase::StaticClass();
 
 		bool bShouldTick = false;
+
+		ETestWorldProfile Profile = ETestWorldProfile::Full;
+
+		// Map each world is a copy of, or none for an empty world.
+		// Loaded once and kept loaded until testing ends
+		TSoftObjectPtr<UWorld> Map;
+
+		bool operator==(const FTestWorldSettings& Other) const
+		{
+			return GameInstance == Other.GameInstance && GameMode == Other.GameMode &&
+				   bShouldTick == Other.bShouldTick && Profile == Other.Profile && Map == Other.Map;
+		}
+	};
+
+	// How TickWorld and TickWorldUntil tick a world
+	struct FTestTickSettings
+	{
+		// Seconds of game time of each tick
+		float Step = 1.f / 60.f;
+
+		// Ticks between calls to the delegate of TickWorldUntil
+		int32 SubSteps = 1;
+
+		ELevelTick TickType = ELevelTick::LEVELTICK_All;
+
+		// Tick groups whose actors and components tick. All of them if empty
+		TArray<ETickingGroup> TickGroups;
+
+		// Only actors and components of these classes tick. All of them if empty
+		TArray<TSubclassOf<AActor>> ActorClasses;
+		TArray<TSubclassOf<UActorComponent>> ComponentClasses;
+
+		bool HasFilters() const
+		{
+			return TickGroups.Num() > 0 || ActorClasses.Num() > 0 || ComponentClasses.Num() > 0;
+		}
+
+		// Components of actors that don't tick don't tick either
+		bool ShouldTick(const AActor* Actor) const
+		{
+			return ShouldTick(Actor, Actor->PrimaryActorTick, ActorClasses);
+		}
+		bool ShouldTick(const UActorComponent* Component) const
+		{
+			return ShouldTick(Component, Component->PrimaryComponentTick, ComponentClasses);
+		}
+
+	private:
+		template <typename T>
+		bool ShouldTick(const UObject* Object, const FTickFunction& TickFunction,
+			const TArray<TSubclassOf<T>>& Classes) const
+		{
+			if (TickGroups.Num() > 0 && !TickGroups.Contains(TickFunction.TickGroup))
+			{
+				return false;
+			}
+			return Classes.Num() <= 0 || Classes.ContainsByPredicate([Object](const TSubclassOf<T>& Class) {
+				return Object->IsA(Class);
+			});
+		}
 	};
 
 	namespace Spec
 	{
+		/////////////////////////////////////////////////////
+		// What is known about an spec class without constructing it
+		struct FSpecInfo
+		{
+			const TCHAR* ClassName;
+			const TCHAR* PrettyName;
+			const ANSICHAR* FileName;
+			int32 LineNumber;
+			uint32 Flags;
+
+			// Module the spec is compiled into. Tests saved to the manifest are only valid for its binary
+			const ANSICHAR* ModuleName = nullptr;
+		};
+
+		class FLazySpec;
+		class FWorldPool;
+
+		/////////////////////////////////////////////////////
+		// State of the actors of a world at some point, restored without recreating the world
+		class FWorldSnapshot
+		{
+			struct FObjectState
+			{
+				TWeakObjectPtr<UObject> Object;
+				TArray<uint8> Properties;
+			};
+
+			struct FActorState
+			{
+				TWeakObjectPtr<AActor> Actor;
+				TArray<uint8> Properties;
+				TArray<FObjectState> Components;
+			};
+
+			// Saves the properties of an object, writing the objects they reference as indices
+			// into the references of the snapshot
+			class FSnapshotWriter : public FObjectWriter
+			{
+				FWorldSnapshot& Snapshot;
+
+			public:
+				FSnapshotWriter(FWorldSnapshot& InSnapshot, UObject* Object, TArray<uint8>& Bytes)
+					: FObjectWriter(Bytes)
+					, Snapshot(InSnapshot)
+				{
+					Object->Serialize(*this);
+				}
+
+				virtual FArchive& operator<<(UObject*& Value) override;
+			};
+
+			// Restores the properties of an object. References to objects destroyed since the
+			// capture are restored as null instead of dangling
+			class FSnapshotReader : public FObjectReader
+			{
+				const FWorldSnapshot& Snapshot;
+
+			public:
+				FSnapshotReader(const FWorldSnapshot& InSnapshot, UObject* Object, TArray<uint8>& Bytes)
+					: FObjectReader(Bytes)
+					, Snapshot(InSnapshot)
+				{
+					Object->Serialize(*this);
+				}
+
+				virtual FArchive& operator<<(UObject*& Value) override;
+			};
+
+			TWeakObjectPtr<UWorld> World;
+			TArray<FActorState> Actors;
+			TSet<TWeakObjectPtr<AActor>> CapturedActors;
+
+			// Objects referenced by captured properties, and their index while capturing
+			TArray<TWeakObjectPtr<UObject>> References;
+			TMap<UObject*, int32> ReferenceIndices;
+
+		public:
+			// Saves the properties of all actors of a world and their components
+			void Capture(UWorld* InWorld);
+
+			// Destroys actors and components created since the capture and restores the properties
+			// of the rest
+			// @return false if the world or an actor of the snapshot was destroyed, so it wasn't restored
+			bool Restore();
+
+			void Reset();
+
+			bool IsCaptured() const
+			{
+				return World.IsValid();
+			}
+			UWorld* GetWorld() const
+			{
+				return World.Get();
+			}
+		};
+
 		class FRegister
 		{
 		public:
@@ -79,6 +325,24 @@ namespace Automatron
 				static FOnSetup Delegate{};
 				return Delegate;
 			}
+
+			// Defines registered specs that were not defined yet.
+			// Specs are defined on worker threads unless they must be defined on the game thread
+			static void DefineSpecsInParallel();
+
+		protected:
+#if AUTOMATRON_LAZY_SPECS
+			using FEntry = FLazySpec;
+#else
+			using FEntry = FTestSpec;
+#endif
+
+			// What each spec registered to the framework
+			static TArray<FEntry*>& Entries()
+			{
+				static TArray<FEntry*> Entries;
+				return Entries;
+			}
 		};
 
 		/////////////////////////////////////////////////////
@@ -98,11 +362,10 @@ namespace Automatron
 			}
 
 		private:
-			static void Setup()
-			{
-				static T Spec{};
-				Spec.Setup();
-			}
+			static void Setup();
+
+			// Constructs a spec that is not registered to the framework
+			static FTestSpec* Create();
 		};
 
 		/////////////////////////////////////////////////////
@@ -138,1309 +401,4877 @@ namespace Automatron
 			}
 		};
 
-		struct FIt
-		{
-			FString Description;
-			FString Id;
-			FString Filename;
-			int32 LineNumber;
-			TSharedRef<IAutomationLatentCommand> Command;
-
-			FIt(FString InDescription, FString InId, FString InFilename, int32 InLineNumber,
-				TSharedRef<IAutomationLatentCommand> InCommand)
-				: Description(MoveTemp(InDescription))
-				, Id(MoveTemp(InId))
-				, Filename(MoveTemp(InFilename))
-				, LineNumber(MoveTemp(InLineNumber))
-				, Command(MoveTemp(InCommand))
-			{}
-		};
-	};	  // namespace Spec
+		/////////////////////////////////////////////////////
+		// Move-only callable that keeps small functors inline instead of allocating them.
+		// Blocks use it so that their lambdas live inside the command that runs them
+		template <typename FuncType>
+		class TInlineFunction;
 
-	namespace Commands
-	{
-		class FSingleExecuteLatent : public IAutomationLatentCommand
+		template <typename Ret, typename... ParamTypes>
+		class TInlineFunction<Ret(ParamTypes...)>
 		{
+		public:
+			// Functors up to this size are stored inline. Bigger ones are allocated
+			static constexpr int32 InlineSize = 48;
+			static constexpr int32 InlineAlignment = 16;
+
 		private:
-			const FTestSpecBase& Spec;
-			const TFunction<void()> Predicate;
-			const bool bSkipIfErrored = false;
+			struct FOps
+			{
+				Ret (*Call)(void* Storage, ParamTypes... Params);
+				// Moves the functor to another storage, leaving this one empty
+				void (*Relocate)(void* Storage, void* Target);
+				void (*Destroy)(void* Storage);
+			};
+
+			template <typename FunctorType, bool bInline>
+			struct TOps
+			{
+				static FunctorType& Get(void* Storage)
+				{
+					if constexpr (bInline)
+					{
+						return *static_cast<FunctorType*>(Storage);
+					}
+					else
+					{
+						return **static_cast<FunctorType**>(Storage);
+					}
+				}
+				static Ret Call(void* Storage, ParamTypes... Params)
+				{
+					// Void signatures discard whatever the functor returns
+					if constexpr (TIsVoidType<Ret>::Value)
+					{
+						Invoke(Get(Storage), Forward<ParamTypes>(Params)...);
+					}
+					else
+					{
+						return Invoke(Get(Storage), Forward<ParamTypes>(Params)...);
+					}
+				}
+				static void Relocate(void* Storage, void* Target)
+				{
+					if constexpr (bInline)
+					{
+						new (Target) FunctorType(MoveTemp(Get(Storage)));
+						Get(Storage).~FunctorType();
+					}
+					else
+					{
+						*static_cast<FunctorType**>(Target) = &Get(Storage);
+					}
+				}
+				static void Destroy(void* Storage)
+				{
+					if constexpr (bInline)
+					{
+						Get(Storage).~FunctorType();
+					}
+					else
+					{
+						delete &Get(Storage);
+					}
+				}
+
+				static constexpr FOps Ops{&Call, &Relocate, &Destroy};
+			};
+
+			mutable TAlignedBytes<InlineSize, InlineAlignment> Storage;
+			const FOps* Ops = nullptr;
 
 		public:
-			FSingleExecuteLatent(
-				const FTestSpecBase& InSpec, TFunction<void()> InPredicate, bool bInSkipIfErrored = false)
-				: Spec(InSpec)
-				, Predicate(MoveTemp(InPredicate))
-				, bSkipIfErrored(bInSkipIfErrored)
-			{}
-			virtual ~FSingleExecuteLatent() {}
+			TInlineFunction() = default;
+			TInlineFunction(TYPE_OF_NULLPTR) {}
+
+			template <typename FunctorType,
+				typename = typename TEnableIf<
+					!TIsSame<typename TDecay<FunctorType>::Type, TInlineFunction>::Value &&
+					TIsInvocable<typename TDecay<FunctorType>::Type&, ParamTypes...>::Value>::Type>
+			TInlineFunction(FunctorType&& Functor)
+			{
+				using FDecayed = typename TDecay<FunctorType>::Type;
+				constexpr bool bInline =
+					sizeof(FDecayed) <= InlineSize && alignof(FDecayed) <= InlineAlignment;
+				if constexpr (bInline)
+				{
+					new (&Storage) FDecayed(Forward<FunctorType>(Functor));
+				}
+				else
+				{
+					*reinterpret_cast<FDecayed**>(&Storage) = new FDecayed(Forward<FunctorType>(Functor));
+				}
+				Ops = &TOps<FDecayed, bInline>::Ops;
+			}
 
-			virtual bool Update() override;
-		};
+			TInlineFunction(TInlineFunction&& Other)
+			{
+				*this = MoveTemp(Other);
+			}
 
-		class FUntilDoneLatent : public IAutomationLatentCommand
-		{
-		private:
-			FTestSpecBase& Spec;
-			const TFunction<void(const FDoneDelegate&)> Predicate;
-			const FTimespan Timeout;
-			const bool bSkipIfErrored = false;
+			TInlineFunction& operator=(TInlineFunction&& Other)
+			{
+				if (this != &Other)
+				{
+					Reset();
+					if (Other.Ops)
+					{
+						Other.Ops->Relocate(&Other.Storage, &Storage);
+						Ops = Other.Ops;
+						Other.Ops = nullptr;
+					}
+				}
+				return *this;
+			}
 
-			bool bIsRunning = false;
-			FThreadSafeBool bDone = false;
-			FDateTime StartedRunning;
+			TInlineFunction(const TInlineFunction&) = delete;
+			TInlineFunction& operator=(const TInlineFunction&) = delete;
 
-		public:
-			FUntilDoneLatent(FTestSpecBase& InSpec, TFunction<void(const FDoneDelegate&)> InPredicate,
-				const FTimespan& InTimeout, bool bInSkipIfErrored = false)
-				: Spec(InSpec)
-				, Predicate(MoveTemp(InPredicate))
-				, Timeout(InTimeout)
-				, bSkipIfErrored(bInSkipIfErrored)
-			{}
-			virtual ~FUntilDoneLatent() {}
+			~TInlineFunction()
+			{
+				Reset();
+			}
 
-			virtual bool Update() override;
+			void Reset()
+			{
+				if (Ops)
+				{
+					Ops->Destroy(&Storage);
+					Ops = nullptr;
+				}
+			}
 
-		private:
-			void Done()
+			Ret operator()(ParamTypes... Params) const
 			{
-				bDone = true;
+				checkf(Ops, TEXT("Attempting to call an unbound TInlineFunction!"));
+				return Ops->Call(&Storage, Forward<ParamTypes>(Params)...);
+			}
+
+			explicit operator bool() const
+			{
+				return Ops != nullptr;
 			}
-			void Reset();
 		};
 
-		class FAsyncUntilDoneLatent : public IAutomationLatentCommand
-		{
-		private:
-			FTestSpecBase& Spec;
-			const EAsyncExecution Execution;
-			const TFunction<void(const FDoneDelegate&)> Predicate;
-			const FTimespan Timeout;
-			const bool bSkipIfErrored = false;
+		// Work of a BeforeEach, It or AfterEach block
+		using FBlockFunction = TInlineFunction<void()>;
 
-			FThreadSafeBool bDone = false;
-			TFuture<void> Future;
-			FDateTime StartedRunning;
+		// Work of a latent block. It must call the delegate when it finishes
+		using FLatentBlockFunction = TInlineFunction<void(const FDoneDelegate&)>;
 
-		public:
-			FAsyncUntilDoneLatent(FTestSpecBase& InSpec, EAsyncExecution InExecution,
-				TFunction<void(const FDoneDelegate&)> InPredicate, const FTimespan& InTimeout,
-				bool bInSkipIfErrored = false)
-				: Spec(InSpec)
-				, Execution(InExecution)
-				, Predicate(MoveTemp(InPredicate))
-				, Timeout(InTimeout)
-				, bSkipIfErrored(bInSkipIfErrored)
-			{}
-			virtual ~FAsyncUntilDoneLatent() {}
+		/////////////////////////////////////////////////////
+		// Tells an async block that it timed out. Blocks check it to stop early, as their worker
+		// can't be interrupted
+		class FCancellationToken
+		{
+			// Shared by copies of the token, so that workers see when their run is canceled
+			TSharedRef<FThreadSafeBool> CanceledFlag = MakeShared<FThreadSafeBool>(false);
 
-			virtual bool Update() override;
+		public:
+			bool IsCanceled() const
+			{
+				return *CanceledFlag;
+			}
 
-		private:
-			void Done()
+			void Cancel() const
 			{
-				bDone = true;
+				*CanceledFlag = true;
 			}
-			void Reset();
 		};
 
-		class FAsyncLatent : public IAutomationLatentCommand
+		/////////////////////////////////////////////////////
+		// Work of an async block. It may take a cancellation token, or ignore it
+		template <typename... ParamTypes>
+		class TAsyncBlockFunction
 		{
-		private:
-			FTestSpecBase& Spec;
-			const EAsyncExecution Execution;
-			const TFunction<void()> Predicate;
-			const FTimespan Timeout;
-			const bool bSkipIfErrored = false;
+			using FFunction = TInlineFunction<void(ParamTypes..., const FCancellationToken&)>;
+			FFunction Function;
 
-			FThreadSafeBool bDone = false;
-			FDateTime StartedRunning;
-			TFuture<void> Future;
+			// Functors that can take the token get it, even if they could also be called without it
+			template <typename FunctorType, typename DecayedType = typename TDecay<FunctorType>::Type>
+			static constexpr bool TakesToken =
+				TIsInvocable<DecayedType&, ParamTypes..., const FCancellationToken&>::Value;
+
+			template <typename FunctorType, typename DecayedType = typename TDecay<FunctorType>::Type>
+			static constexpr bool IgnoresToken =
+				!TakesToken<FunctorType> && TIsInvocable<DecayedType&, ParamTypes...>::Value;
 
 		public:
-			FAsyncLatent(FTestSpecBase& InSpec, EAsyncExecution InExecution, TFunction<void()> InPredicate,
-				const FTimespan& InTimeout, bool bInSkipIfErrored = false)
-				: Spec(InSpec)
-				, Execution(InExecution)
-				, Predicate(MoveTemp(InPredicate))
-				, Timeout(InTimeout)
-				, bSkipIfErrored(bInSkipIfErrored)
+			template <typename FunctorType, typename TEnableIf<TakesToken<FunctorType>, int>::Type = 0>
+			TAsyncBlockFunction(FunctorType&& Functor)
+				: Function(Forward<FunctorType>(Functor))
 			{}
-			virtual ~FAsyncLatent() {}
 
-			virtual bool Update() override;
+			template <typename FunctorType, typename TEnableIf<IgnoresToken<FunctorType>, bool>::Type = false>
+			TAsyncBlockFunction(FunctorType&& Functor)
+				: Function([Work = typename TDecay<FunctorType>::Type(Forward<FunctorType>(Functor))](
+							   ParamTypes... Params, const FCancellationToken&) mutable {
+					Work(Params...);
+				})
+			{}
 
-		private:
-			void Done()
+			void operator()(ParamTypes... Params, const FCancellationToken& Token) const
 			{
-				bDone = true;
+				Function(Params..., Token);
 			}
-			void Reset();
 		};
-	};	  // namespace Commands
 
-	class FTestSpecBase : public FAutomationTestBase, public TSharedFromThis<FTestSpecBase>
-	{
-	private:
-		struct FSpecDefinitionScope
+		using FAsyncBlockFunction = TAsyncBlockFunction<>;
+		using FAsyncLatentBlockFunction = TAsyncBlockFunction<const FDoneDelegate&>;
+
+		/////////////////////////////////////////////////////
+		// Errors, warnings and infos of a test reported from worker threads. Workers append to it
+		// without locking, and the game thread reports them to the test in the order they were added
+		class FEventSink
 		{
-			FString Description;
+		public:
+			enum class EType : uint8
+			{
+				Error,
+				Warning,
+				Info
+			};
 
-			TArray<TSharedRef<IAutomationLatentCommand>> BeforeEach;
-			TArray<TSharedRef<Spec::FIt>> It;
-			TArray<TSharedRef<IAutomationLatentCommand>> AfterEach;
+		private:
+			struct FEvent
+			{
+				EType Type = EType::Info;
+				FString Message;
+			};
 
-			TArray<TSharedRef<FSpecDefinitionScope>> Children;
-		};
+			TQueue<FEvent, EQueueMode::Mpsc> Events;
+			FThreadSafeBool bHasErrors;
 
-		struct FSpec
-		{
-			FString Id;
-			FString Description;
-			FString Filename;
-			int32 LineNumber;
-			TArray<TSharedRef<IAutomationLatentCommand>> Commands;
-		};
+		public:
+			explicit FEventSink(bool bInHasErrors = false)
+				: bHasErrors(bInHasErrors)
+			{}
 
-	protected:
-		/* The timespan for how long a block should be allowed to execute before
-		 * giving up and failing the test */
-		FTimespan DefaultTimeout = FTimespan::FromSeconds(30);
+			// Thread-safe
+			void Add(EType Type, const FString& Message)
+			{
+				Events.Enqueue({Type, Message});
+				if (Type == EType::Error)
+				{
+					bHasErrors = true;
+				}
+			}
+
+			bool HasErrors() const
+			{
+				return bHasErrors;
+			}
+
+			// Reports the events added so far to the test. Game thread only
+			void Flush(FAutomationTestBase& Test)
+			{
+				FEvent Event;
+				while (Events.Dequeue(Event))
+				{
+					switch (Event.Type)
+					{
+						case EType::Error:
+							Test.FAutomationTestBase::AddError(Event.Message);
+							break;
+						case EType::Warning:
+							Test.FAutomationTestBase::AddWarning(Event.Message);
+							break;
+						case EType::Info:
+							Test.FAutomationTestBase::AddInfo(Event.Message);
+							break;
+					}
+				}
+			}
+		};
+
+		/////////////////////////////////////////////////////
+		// State of one run of an async block. Shared with its worker, which may outlive the run
+		// if it doesn't stop after timing out
+		struct FAsyncRun : public TSharedFromThis<FAsyncRun>
+		{
+			// Spec to wake when the block is done. Never dereferenced, since it may be gone by then
+			const FTestSpecBase* const Spec;
+
+			// Work of the block, sharing its functor with other runs of the command. Workers only use
+			// the run, so that a stuck one can outlive its command.
+			// @return true if the block is done once it returns
+			TUniqueFunction<bool(FAsyncRun&)> Block;
+
+			// Events its worker reported, so that they are never attributed to a later test
+			FEventSink Events;
+
+			FCancellationToken Token;
+			FThreadSafeBool bDone = false;
+
+			// Set once its command stopped waiting for it, so that it doesn't wake the spec anymore
+			FThreadSafeBool bAbandoned = false;
+
+			// Cleared once its worker returned from the block
+			FThreadSafeBool bWorkerRunning = true;
+			double StartTime = 0.0;
+
+			// When it was canceled after timing out, or 0
+			double CancelTime = 0.0;
+
+			// Errors the test had when it started, so that workers can skip if errored
+			FAsyncRun(const FTestSpecBase& InSpec, bool bHasErrors)
+				: Spec(&InSpec)
+				, Events(bHasErrors)
+			{}
+		};
+
+		/////////////////////////////////////////////////////
+		// Threads owned by Automatron to run async blocks on, so that they don't compete with engine
+		// tasks and loading. Created on first use and destroyed when testing ends
+		class FWorkerPool
+		{
+			TUniquePtr<FQueuedThreadPool> Pool;
+
+			// Blocks launched and not started yet
+			TAtomic<int32> QueueDepth{0};
+
+			mutable FCriticalSection StatsLock;
+			int32 MaxQueueDepth = 0;
+			int32 NumLaunched = 0;
+			double WaitTime = 0.0;
+			double MaxWaitTime = 0.0;
+
+			// Settings of the threads, applied when the pool is created
+			int32 NumThreads = 4;
+			EThreadPriority Priority = TPri_Normal;
+			uint32 StackSize = 256 * 1024;
+
+		public:
+			static AUTOMATRON_API FWorkerPool& Get();
+
+			// Sets up the threads of the pool before they are created on first use
+			// @return false if they already exist. They are destroyed when testing ends
+			bool Configure(int32 InNumThreads, EThreadPriority InPriority = TPri_Normal,
+				uint32 InStackSize = 256 * 1024);
+
+			TFuture<void> Launch(TUniqueFunction<void()> Work);
+
+			// Destroys the threads, unless a worker is stuck on them
+			void Shutdown();
+
+			int32 GetQueueDepth() const
+			{
+				return QueueDepth;
+			}
+
+			// @return seconds blocks waited in the queue before starting, on average
+			double GetAverageWaitTime() const
+			{
+				FScopeLock ScopeLock(&StatsLock);
+				return NumLaunched > 0 ? WaitTime / NumLaunched : 0.0;
+			}
+
+		private:
+			FWorkerPool()
+			{
+				FAutomationTestFramework::Get().PostTestingEvent.AddRaw(this, &FWorkerPool::Shutdown);
+				FCoreDelegates::OnPreExit.AddRaw(this, &FWorkerPool::Shutdown);
+			}
+		};
+
+		/////////////////////////////////////////////////////
+		// Where an async block runs: with an engine execution, or on Automatron's worker pool
+		struct FAsyncExecution
+		{
+			EAsyncExecution Execution = EAsyncExecution::ThreadPool;
+			bool bWorkerPool = false;
+
+			FAsyncExecution(EAsyncExecution InExecution)
+				: Execution(InExecution)
+			{}
+
+			static FAsyncExecution WorkerPool()
+			{
+				FAsyncExecution Result{EAsyncExecution::ThreadPool};
+				Result.bWorkerPool = true;
+				return Result;
+			}
+
+			// @return whether it shares its threads with other work
+			bool IsShared() const
+			{
+				return bWorkerPool || Execution == EAsyncExecution::TaskGraph ||
+					   Execution == EAsyncExecution::ThreadPool ||
+					   Execution == EAsyncExecution::LargeThreadPool;
+			}
+
+			TFuture<void> Launch(TUniqueFunction<void()> Work) const
+			{
+				if (bWorkerPool)
+				{
+					return FWorkerPool::Get().Launch(MoveTemp(Work));
+				}
+				return Async(Execution, MoveTemp(Work));
+			}
+		};
+
+		/////////////////////////////////////////////////////
+		// Workers of async blocks that kept running after being canceled. While any does, new async
+		// blocks run on their own thread instead of queueing behind them on a shared pool
+		class FStuckWorkers
+		{
+			struct FWorker
+			{
+				FString TestName;
+				TFuture<void> Future;
+			};
+
+			TArray<FWorker> Workers;
+			bool bRerouted = false;
+
+		public:
+			static AUTOMATRON_API FStuckWorkers& Get();
+
+			void Add(const FString& TestName, TFuture<void>&& Future)
+			{
+				Workers.Add({TestName, MoveTemp(Future)});
+			}
+
+			// @return workers still running, forgetting those that finished
+			int32 Num()
+			{
+				for (int32 Index = Workers.Num() - 1; Index >= 0; --Index)
+				{
+					if (Workers[Index].Future.IsReady())
+					{
+						Workers.RemoveAtSwap(Index);
+					}
+				}
+				return Workers.Num();
+			}
+
+			// @return where an async block should run, given the workers still stuck
+			FAsyncExecution Reroute(const FAsyncExecution& Execution);
+
+			// Warns about workers still running
+			void Report();
+
+		private:
+			FStuckWorkers()
+			{
+				FAutomationTestFramework::Get().PostTestingEvent.AddRaw(this, &FStuckWorkers::Report);
+			}
+		};
+
+#if AUTOMATRON_COROUTINES
+		// Resumes the waiting command of the spec at the end of the frame. Thread-safe
+		inline void WakeSpec(FTestSpecBase& Spec);
+
+		/////////////////////////////////////////////////////
+		// Recycles the frames of coroutine blocks, so that running them again doesn't allocate
+		class FCoroutineFramePool
+		{
+			// Frames are pooled by size in steps of Granularity. Bigger frames are not pooled
+			static constexpr SIZE_T Granularity = 64;
+			static constexpr int32 NumBuckets = 32;
+
+			struct FFreeFrame
+			{
+				FFreeFrame* Next = nullptr;
+			};
+
+			FCriticalSection Lock;
+			FFreeFrame* FreeFrames[NumBuckets] = {};
+
+		public:
+			static FCoroutineFramePool& Get()
+			{
+				static FCoroutineFramePool Pool;
+				return Pool;
+			}
+
+			void* Allocate(SIZE_T Size)
+			{
+				const int32 Bucket = GetBucket(Size);
+				if (Bucket >= NumBuckets)
+				{
+					return FMemory::Malloc(Size);
+				}
+
+				{
+					FScopeLock ScopeLock(&Lock);
+					if (FFreeFrame* Frame = FreeFrames[Bucket])
+					{
+						FreeFrames[Bucket] = Frame->Next;
+						return Frame;
+					}
+				}
+				return FMemory::Malloc((Bucket + 1) * Granularity);
+			}
+
+			void Free(void* Frame, SIZE_T Size)
+			{
+				const int32 Bucket = GetBucket(Size);
+				if (Bucket >= NumBuckets)
+				{
+					FMemory::Free(Frame);
+					return;
+				}
+
+				FScopeLock ScopeLock(&Lock);
+				FFreeFrame* FreeFrame = new (Frame) FFreeFrame{FreeFrames[Bucket]};
+				FreeFrames[Bucket] = FreeFrame;
+			}
+
+			// Frees the pooled frames. Frames in use are pooled again when freed
+			void Empty()
+			{
+				FScopeLock ScopeLock(&Lock);
+				for (FFreeFrame*& Frame : FreeFrames)
+				{
+					while (Frame)
+					{
+						FFreeFrame* const Next = Frame->Next;
+						FMemory::Free(Frame);
+						Frame = Next;
+					}
+				}
+			}
+
+		private:
+			FCoroutineFramePool()
+			{
+				FAutomationTestFramework::Get().PostTestingEvent.AddRaw(this, &FCoroutineFramePool::Empty);
+			}
+
+			static int32 GetBucket(SIZE_T Size)
+			{
+				return int32((Size - 1) / Granularity);
+			}
+		};
+
+		class FAwaitable;
+
+		/////////////////////////////////////////////////////
+		// Return type of coroutine blocks. Starts suspended and is resumed by its command
+		// every time what it awaits is ready
+		class FCoroutine
+		{
+		public:
+			struct promise_type
+			{
+				FTestSpecBase* Spec = nullptr;
+				FAwaitable* Awaiting = nullptr;
+
+				FCoroutine get_return_object()
+				{
+					return FCoroutine{std::coroutine_handle<promise_type>::from_promise(*this)};
+				}
+				std::suspend_always initial_suspend() noexcept
+				{
+					return {};
+				}
+				std::suspend_always final_suspend() noexcept
+				{
+					return {};
+				}
+				void return_void() {}
+
+				// Fails the test. The coroutine is done after it, so its block finishes
+				void unhandled_exception();
+
+				static void* operator new(SIZE_T Size)
+				{
+					return FCoroutineFramePool::Get().Allocate(Size);
+				}
+				static void operator delete(void* Frame, SIZE_T Size)
+				{
+					FCoroutineFramePool::Get().Free(Frame, Size);
+				}
+			};
+			using FHandle = std::coroutine_handle<promise_type>;
+
+			FCoroutine() = default;
+			explicit FCoroutine(FHandle InHandle)
+				: Handle(InHandle)
+			{}
+			FCoroutine(FCoroutine&& Other)
+				: Handle(Other.Handle)
+			{
+				Other.Handle = nullptr;
+			}
+			FCoroutine& operator=(FCoroutine&& Other)
+			{
+				if (this != &Other)
+				{
+					Reset();
+					Handle = Other.Handle;
+					Other.Handle = nullptr;
+				}
+				return *this;
+			}
+			FCoroutine(const FCoroutine&) = delete;
+			FCoroutine& operator=(const FCoroutine&) = delete;
+
+			~FCoroutine()
+			{
+				Reset();
+			}
+
+			void Start(FTestSpecBase& Spec)
+			{
+				Handle.promise().Spec = &Spec;
+			}
+
+			// @return true if not finished and what it awaits is ready
+			bool CanResume() const;
+
+			// @return true if what it awaits waits on world time
+			bool WaitsOnTime() const;
+
+			void Resume()
+			{
+				Handle.promise().Awaiting = nullptr;
+				Handle.resume();
+			}
+
+			bool IsValid() const
+			{
+				return static_cast<bool>(Handle);
+			}
+
+			bool IsDone() const
+			{
+				return Handle.done();
+			}
+
+			void Reset()
+			{
+				if (Handle)
+				{
+					Handle.destroy();
+					Handle = nullptr;
+				}
+			}
+
+		private:
+			FHandle Handle;
+		};
+
+		/////////////////////////////////////////////////////
+		// Something a coroutine block can co_await. Checked every time its command updates,
+		// and right after what it waits on wakes the spec
+		class FAwaitable
+		{
+		public:
+			virtual ~FAwaitable() {}
+
+			bool await_ready() const
+			{
+				return false;
+			}
+			void await_suspend(FCoroutine::FHandle Handle)
+			{
+				Handle.promise().Awaiting = this;
+				OnSuspend(*Handle.promise().Spec);
+			}
+			void await_resume() {}
+
+			// @return true once the coroutine can continue
+			virtual bool IsReady(FTestSpecBase& Spec) const = 0;
+
+			// @return true if it waits on world time, so that virtual time can advance while awaited
+			virtual bool WaitsOnTime() const
+			{
+				return false;
+			}
+
+		protected:
+			virtual void OnSuspend(FTestSpecBase& Spec) {}
+		};
+
+		inline bool FCoroutine::CanResume() const
+		{
+			const promise_type& Promise = Handle.promise();
+			return !Handle.done() && (!Promise.Awaiting || Promise.Awaiting->IsReady(*Promise.Spec));
+		}
+
+		inline bool FCoroutine::WaitsOnTime() const
+		{
+			const promise_type& Promise = Handle.promise();
+			return !Handle.done() && Promise.Awaiting && Promise.Awaiting->WaitsOnTime();
+		}
+
+		// Waits a number of frames
+		class FTicksAwaitable : public FAwaitable
+		{
+			const int32 NumTicks;
+			uint64 TargetFrame = 0;
+
+		public:
+			explicit FTicksAwaitable(int32 InNumTicks)
+				: NumTicks(InNumTicks)
+			{}
+
+			virtual bool IsReady(FTestSpecBase& Spec) const override
+			{
+				return GFrameCounter >= TargetFrame;
+			}
+			virtual bool WaitsOnTime() const override
+			{
+				return true;
+			}
+
+		protected:
+			virtual void OnSuspend(FTestSpecBase& Spec) override
+			{
+				TargetFrame = GFrameCounter + NumTicks;
+			}
+		};
+
+		// Waits a duration of the spec's time, virtual if used
+		class FDelayAwaitable : public FAwaitable
+		{
+			const FTimespan Duration;
+			double Deadline = 0.0;
+
+		public:
+			explicit FDelayAwaitable(const FTimespan& InDuration)
+				: Duration(InDuration)
+			{}
+
+			virtual bool IsReady(FTestSpecBase& Spec) const override;
+			virtual bool WaitsOnTime() const override
+			{
+				return true;
+			}
+
+		protected:
+			virtual void OnSuspend(FTestSpecBase& Spec) override;
+		};
+
+		// Waits until a condition is met, such as a state of the world
+		class FConditionAwaitable : public FAwaitable
+		{
+			const TFunction<bool()> Condition;
+
+		public:
+			explicit FConditionAwaitable(TFunction<bool()> InCondition)
+				: Condition(MoveTemp(InCondition))
+			{}
+
+			virtual bool IsReady(FTestSpecBase& Spec) const override
+			{
+				return Condition();
+			}
+		};
+
+		// Waits until some work calls its done delegate, as a latent block would
+		class FDoneAwaitable : public FAwaitable
+		{
+			const FLatentBlockFunction DoWork;
+			const TSharedRef<FThreadSafeBool> DoneFlag = MakeShared<FThreadSafeBool>(false);
+
+		public:
+			explicit FDoneAwaitable(FLatentBlockFunction InDoWork)
+				: DoWork(MoveTemp(InDoWork))
+			{}
+
+			virtual bool IsReady(FTestSpecBase& Spec) const override
+			{
+				return *DoneFlag;
+			}
+
+		protected:
+			virtual void OnSuspend(FTestSpecBase& Spec) override
+			{
+				FTestSpecBase* SpecPtr = &Spec;
+				DoWork(FDoneDelegate::CreateLambda([InDoneFlag = DoneFlag, SpecPtr]() {
+					*InDoneFlag = true;
+					WakeSpec(*SpecPtr);
+				}));
+			}
+		};
+
+		// Waits for a future and resumes with its value
+		template <typename T>
+		class TFutureAwaitable : public FAwaitable
+		{
+			TFuture<T> Future;
+
+		public:
+			explicit TFutureAwaitable(TFuture<T>&& InFuture)
+				: Future(MoveTemp(InFuture))
+			{}
+
+			decltype(auto) await_resume()
+			{
+				return Future.Get();
+			}
+
+			virtual bool IsReady(FTestSpecBase& Spec) const override
+			{
+				return Future.IsReady();
+			}
+
+		protected:
+			virtual void OnSuspend(FTestSpecBase& Spec) override
+			{
+				FTestSpecBase* SpecPtr = &Spec;
+				Future = Future.Then([SpecPtr](TFuture<T> Ready) {
+					WakeSpec(*SpecPtr);
+					return Ready.Get();
+				});
+			}
+		};
+
+		// Waits until a multicast delegate broadcasts
+		template <typename TDelegate>
+		class TEventAwaitable : public FAwaitable
+		{
+			TDelegate& Delegate;
+			FDelegateHandle Handle;
+			const TSharedRef<FThreadSafeBool> BroadcastFlag = MakeShared<FThreadSafeBool>(false);
+
+			// Object the delegate is a member of, if any. Once it is collected, so is the delegate
+			const TWeakObjectPtr<const UObject> Owner;
+			const bool bHasOwner = false;
+
+		public:
+			explicit TEventAwaitable(TDelegate& InDelegate, const UObject* InOwner = nullptr)
+				: Delegate(InDelegate)
+				, Owner(InOwner)
+				, bHasOwner(InOwner != nullptr)
+			{}
+			virtual ~TEventAwaitable()
+			{
+				if (!bHasOwner || Owner.IsValid(true))
+				{
+					Delegate.Remove(Handle);
+				}
+			}
+
+			virtual bool IsReady(FTestSpecBase& Spec) const override
+			{
+				return *BroadcastFlag;
+			}
+
+		protected:
+			virtual void OnSuspend(FTestSpecBase& Spec) override
+			{
+				FTestSpecBase* SpecPtr = &Spec;
+				Handle = Delegate.AddLambda([InBroadcastFlag = BroadcastFlag, SpecPtr](auto&&...) {
+					*InBroadcastFlag = true;
+					WakeSpec(*SpecPtr);
+				});
+			}
+		};
+
+		// Work of a coroutine block. What it captures lives as long as the spec
+		using FCoroutineFunction = TInlineFunction<FCoroutine()>;
+#endif
+
+		/////////////////////////////////////////////////////
+		// A command defined by a BeforeEach, It or AfterEach
+		struct FBlock
+		{
+			TSharedPtr<IAutomationLatentCommand> Command;
+
+			// Why this block can't run inline, or null if it finishes as soon as it runs
+			const TCHAR* LatentReason = nullptr;
+
+			// Whether it was defined by the spec itself to keep its per-test state. When tests run in
+			// parallel, it still runs on the game thread
+			bool bInternal = false;
+
+			FBlock() = default;
+			FBlock(TSharedRef<IAutomationLatentCommand> InCommand, const TCHAR* InLatentReason = nullptr)
+				: Command(MoveTemp(InCommand))
+				, LatentReason(InLatentReason)
+			{}
+		};
+
+		/////////////////////////////////////////////////////
+		// File and line where a block was written, captured at compile time.
+		// Used as a default argument so that it resolves to the caller's location
+		struct FSourceLocation
+		{
+			// Static string, null if the compiler can't provide it
+			const ANSICHAR* File = nullptr;
+			int32 Line = 0;
+
+#if AUTOMATRON_HAS_SOURCE_LOCATION
+			static constexpr FSourceLocation Current(
+				const ANSICHAR* InFile = __builtin_FILE(), int32 InLine = __builtin_LINE())
+			{
+				return {InFile, InLine};
+			}
+#else
+			static constexpr FSourceLocation Current()
+			{
+				return {};
+			}
+#endif
+
+			bool IsValid() const
+			{
+				return File != nullptr;
+			}
+		};
+
+		/////////////////////////////////////////////////////
+		// Order in which the tests of an spec run when all of them run together
+		enum class EExecutionOrder : uint8
+		{
+			// As they are declared
+			Declaration,
+			// Grouped by what they wait for (nothing, a world, async work...) in order of appearance.
+			// Tests that can run inline go first, so they don't get queued behind latent ones
+			Affinity,
+			// Slowest tests in the previous run go first. Declaration order until then
+			SlowestFirst
+		};
+
+		/////////////////////////////////////////////////////
+		// Counters collected while running the tests of an spec
+		struct FStats
+		{
+			// Tests that ran inside RunTest instead of through the latent command queue
+			int32 InlineTests = 0;
+
+			// Seconds tests waited for their world to be prepared
+			double WorldPrepTime = 0.0;
+
+			// Latent blocks that signaled they were done, and seconds until their command resumed
+			int32 LatentWaits = 0;
+			double WaitLatency = 0.0;
+			double MaxWaitLatency = 0.0;
+
+			// Commands resumed as soon as a block was done, before the framework polled them
+			int32 EarlyResumes = 0;
+		};
+
+		// @return id of a test from its test name, which may start with the name of its spec
+		inline FStringView GetTestIdFromName(FStringView InTestName, FStringView SpecName)
+		{
+			if (InTestName.Len() > SpecName.Len() && InTestName[SpecName.Len()] == TEXT(' ') &&
+				InTestName.StartsWith(SpecName))
+			{
+				InTestName.RightChopInline(SpecName.Len() + 1);
+			}
+			return InTestName;
+		}
+	};	  // namespace Spec
+
+	namespace Commands
+	{
+		class FCompositeLatent;
+		class FCoroutineLatent;
+
+		/////////////////////////////////////////////////////
+		// Resumes the waiting command of a spec as soon as one of its blocks is done, at the end of
+		// the frame it was done on, instead of a frame later when the framework polls it again
+		class FLatentScheduler
+		{
+			struct FWaitingSpec
+			{
+				TWeakPtr<FCompositeLatent> Command;
+
+				// Cycles when a block of the spec was done, or 0 if none is
+				uint64 DoneCycles = 0;
+			};
+
+			FCriticalSection Lock;
+			TMap<const FTestSpecBase*, FWaitingSpec> Specs;
+			int32 NumWoken = 0;
+
+		public:
+			static AUTOMATRON_API FLatentScheduler& Get();
+
+			// Starts resuming this command of the spec when its blocks are done
+			void Schedule(const FTestSpecBase& Spec, const TSharedRef<FCompositeLatent>& Command);
+			void Unschedule(const FTestSpecBase& Spec);
+
+			// Called when a block of the spec is done. Ignored if the spec isn't scheduled. Thread-safe
+			void Wake(const FTestSpecBase& Spec);
+
+			// @return seconds since a block of the spec was done, or a negative value if none was
+			double ConsumeWaitLatency(const FTestSpecBase& Spec);
+
+		private:
+			FLatentScheduler()
+			{
+				FCoreDelegates::OnEndFrame.AddRaw(this, &FLatentScheduler::ResumeWoken);
+				FAutomationTestFramework::Get().PostTestingEvent.AddRaw(this, &FLatentScheduler::Empty);
+			}
+
+			// Resumes commands of woken specs, only while tests run
+			void ResumeWoken();
+
+			// Forgets all specs, so that commands left over by canceled tests are never resumed
+			void Empty();
+		};
+
+		class FSingleExecuteLatent : public IAutomationLatentCommand
+		{
+		private:
+			const FTestSpecBase& Spec;
+			const Spec::FBlockFunction Predicate;
+			const bool bSkipIfErrored = false;
+
+		public:
+			FSingleExecuteLatent(
+				const FTestSpecBase& InSpec, Spec::FBlockFunction InPredicate, bool bInSkipIfErrored = false)
+				: Spec(InSpec)
+				, Predicate(MoveTemp(InPredicate))
+				, bSkipIfErrored(bInSkipIfErrored)
+			{}
+			virtual ~FSingleExecuteLatent() {}
+
+			virtual bool Update() override;
+		};
+
+		class FUntilDoneLatent : public IAutomationLatentCommand
+		{
+		private:
+			FTestSpecBase& Spec;
+			const Spec::FLatentBlockFunction Predicate;
+			const FTimespan Timeout;
+			const bool bSkipIfErrored = false;
+
+			bool bIsRunning = false;
+			FThreadSafeBool bDone = false;
+
+			// Whether the running block waits on world time, so that it warps virtual time
+			bool bWarpsTime = false;
+			double StartedRunning = 0.0;
+
+		public:
+			FUntilDoneLatent(FTestSpecBase& InSpec, Spec::FLatentBlockFunction InPredicate,
+				const FTimespan& InTimeout, bool bInSkipIfErrored = false)
+				: Spec(InSpec)
+				, Predicate(MoveTemp(InPredicate))
+				, Timeout(InTimeout)
+				, bSkipIfErrored(bInSkipIfErrored)
+			{}
+			virtual ~FUntilDoneLatent() {}
+
+			virtual bool Update() override;
+
+		private:
+			void Done()
+			{
+				bDone = true;
+				FLatentScheduler::Get().Wake(Spec);
+			}
+			void Reset();
+
+			// @return seconds of the time the running block waits in, virtual or real
+			double GetTime() const;
+		};
+
+		/////////////////////////////////////////////////////
+		// Runs a block on a worker thread. When it times out, it is canceled and given a grace period
+		// to stop. Workers still running after it are tracked as stuck
+		class FAsyncLatentBase : public IAutomationLatentCommand
+		{
+		protected:
+			FTestSpecBase& Spec;
+			const Spec::FAsyncExecution Execution;
+			const FTimespan Timeout;
+			const bool bSkipIfErrored = false;
+
+			TSharedPtr<Spec::FAsyncRun> Run;
+			TFuture<void> Future;
+
+			// Previous run whose worker was still in the block when the command stopped waiting for it.
+			// The block can't run again until it returned, since both runs would share its state
+			TSharedPtr<Spec::FAsyncRun> PreviousRun;
+
+		public:
+			FAsyncLatentBase(FTestSpecBase& InSpec, Spec::FAsyncExecution InExecution,
+				const FTimespan& InTimeout, bool bInSkipIfErrored)
+				: Spec(InSpec)
+				, Execution(InExecution)
+				, Timeout(InTimeout)
+				, bSkipIfErrored(bInSkipIfErrored)
+			{}
+			virtual ~FAsyncLatentBase() {}
+
+			virtual bool Update() override;
+
+		protected:
+			// @return the work of a run of the block
+			virtual TUniqueFunction<bool(Spec::FAsyncRun&)> MakeBlock() const = 0;
+
+			// Called when the block of a run is done. Thread-safe
+			static void Done(Spec::FAsyncRun& InRun)
+			{
+				InRun.bDone = true;
+				if (!InRun.bAbandoned)
+				{
+					FLatentScheduler::Get().Wake(*InRun.Spec);
+				}
+			}
+
+		private:
+			// Runs the block on its worker, sending the events it reports to the run
+			static void RunOnWorker(Spec::FAsyncRun& InRun);
+
+			void Reset();
+		};
+
+		class FAsyncUntilDoneLatent : public FAsyncLatentBase
+		{
+		private:
+			const TSharedRef<Spec::FAsyncLatentBlockFunction> Predicate;
+
+		public:
+			FAsyncUntilDoneLatent(FTestSpecBase& InSpec, Spec::FAsyncExecution InExecution,
+				Spec::FAsyncLatentBlockFunction InPredicate, const FTimespan& InTimeout,
+				bool bInSkipIfErrored = false)
+				: FAsyncLatentBase(InSpec, InExecution, InTimeout, bInSkipIfErrored)
+				, Predicate(MakeShared<Spec::FAsyncLatentBlockFunction>(MoveTemp(InPredicate)))
+			{}
+			virtual ~FAsyncUntilDoneLatent() {}
+
+		protected:
+			virtual TUniqueFunction<bool(Spec::FAsyncRun&)> MakeBlock() const override;
+		};
+
+		class FAsyncLatent : public FAsyncLatentBase
+		{
+		private:
+			const TSharedRef<Spec::FAsyncBlockFunction> Predicate;
+
+		public:
+			FAsyncLatent(FTestSpecBase& InSpec, Spec::FAsyncExecution InExecution,
+				Spec::FAsyncBlockFunction InPredicate, const FTimespan& InTimeout,
+				bool bInSkipIfErrored = false)
+				: FAsyncLatentBase(InSpec, InExecution, InTimeout, bInSkipIfErrored)
+				, Predicate(MakeShared<Spec::FAsyncBlockFunction>(MoveTemp(InPredicate)))
+			{}
+			virtual ~FAsyncLatent() {}
+
+		protected:
+			virtual TUniqueFunction<bool(Spec::FAsyncRun&)> MakeBlock() const override;
+		};
+
+#if AUTOMATRON_COROUTINES
+		class FCoroutineLatent : public IAutomationLatentCommand
+		{
+		private:
+			FTestSpecBase& Spec;
+			const Spec::FCoroutineFunction Body;
+			const FTimespan Timeout;
+			const bool bSkipIfErrored = false;
+
+			Spec::FCoroutine Coroutine;
+			double StartedRunning = 0.0;
+
+		public:
+			FCoroutineLatent(FTestSpecBase& InSpec, Spec::FCoroutineFunction InBody,
+				const FTimespan& InTimeout, bool bInSkipIfErrored = false)
+				: Spec(InSpec)
+				, Body(MoveTemp(InBody))
+				, Timeout(InTimeout)
+				, bSkipIfErrored(bInSkipIfErrored)
+			{}
+			virtual ~FCoroutineLatent() {}
+
+			virtual bool Update() override;
+		};
+#endif
+
+		/////////////////////////////////////////////////////
+		// Runs a list of commands back-to-back on the same frame.
+		// Only yields when a command is still in progress
+		class FCompositeLatent : public IAutomationLatentCommand
+		{
+		private:
+			FTestSpecBase& Spec;
+			const int32 SpecIndex;
+			const TArray<TSharedRef<IAutomationLatentCommand>> Commands;
+
+			int32 CurrentIndex = 0;
+			double StartTime = 0.0;
+
+			bool bUpdating = false;
+			bool bScheduled = false;
+
+			// Whether it finished when resumed by the scheduler, before the framework polled it
+			bool bFinished = false;
+
+		public:
+			FCompositeLatent(FTestSpecBase& InSpec, int32 InSpecIndex,
+				TArray<TSharedRef<IAutomationLatentCommand>> InCommands)
+				: Spec(InSpec)
+				, SpecIndex(InSpecIndex)
+				, Commands(MoveTemp(InCommands))
+			{}
+			virtual ~FCompositeLatent() {}
+
+			virtual bool Update() override;
+
+			// Continues running commands without waiting to be polled. Game thread only
+			void Resume();
+
+		private:
+			// @return true once all commands finished
+			bool Step();
+		};
+	};	  // namespace Commands
+
+	class FTestSpecBase : public FAutomationTestBase, public TSharedFromThis<FTestSpecBase>
+	{
+	private:
+		// A Describe, or the root of the spec
+		struct FScope
+		{
+			int32 Parent = INDEX_NONE;
+
+			// Description of the Describe in the name table, or INDEX_NONE for the root
+			int32 Name = INDEX_NONE;
+
+			// BeforeEach blocks of this scope followed by its AfterEach blocks, starting at FirstBlock
+			int32 FirstBlock = 0;
+			int32 NumBeforeEach = 0;
+			int32 NumAfterEach = 0;
+
+			// First reason found in this scope or its parents why their tests can't run inline
+			const TCHAR* LatentReason = nullptr;
+		};
+
+		// A BeforeEach or AfterEach block as defined, before blocks are laid out by scope.
+		// Lives in DefinitionMemory
+		struct FDefinedBlock
+		{
+			Spec::FBlock Block;
+			int32 Scope;
+			bool bAfterEach;
+			FDefinedBlock* Next = nullptr;
+		};
+
+		// A test. Its full description and id are built from the names of its scopes when needed
+		struct FSpec
+		{
+			// Description of the It in the name table
+			int32 Name;
+			Spec::FSourceLocation Location;
+
+			// Innermost scope of this spec. BeforeEach and AfterEach blocks are found walking its parents
+			int32 Scope;
+
+			// The It block
+			Spec::FBlock Block;
+
+			// Why this spec can't run inline, or null if it can
+			const TCHAR* LatentReason = nullptr;
+
+			// Seconds it took to run the last time, or 0 if it didn't run yet
+			double LastDuration = 0.0;
+
+			FSpec(int32 InName, const Spec::FSourceLocation& InLocation, int32 InScope, Spec::FBlock InBlock)
+				: Name(InName)
+				, Location(InLocation)
+				, Scope(InScope)
+				, Block(MoveTemp(InBlock))
+			{}
+		};
+
+	protected:
+		/* The timespan for how long a block should be allowed to execute before
+		 * giving up and failing the test */
+		FTimespan DefaultTimeout = FTimespan::FromSeconds(30);
+
+		/* How long an async block that timed out has to stop once canceled, before its worker
+		 * is considered stuck */
+		FTimespan AsyncGracePeriod = FTimespan::FromSeconds(2);
+
+		/* Whether or not BeforeEach and It blocks should skip execution if the test
+		 * has already failed */
+		bool bEnableSkipIfError = true;
+
+		/* Whether or not tests of this spec are thread-safe. When all its tests run at once, those that
+		 * can run inline run concurrently on worker threads. Their events are reported in plan order.
+		 * Only It blocks run on workers: tests with BeforeEach or AfterEach blocks run on the game thread
+		 * afterwards. Internal blocks run once the workers are done, so parallel tests see their own
+		 * context but not the state those set up, like worlds. Only errors reported through the spec
+		 * reach their test: UE_LOG and ensure on workers are not captured */
+		bool bThreadSafeTests = false;
+
+		/* Whether or not test names should show why a test can't run inline
+		 * (e.g "Test (latent: LatentIt)") */
+		bool bShowExecutionPath = false;
+
+		/* Order in which tests run when the whole spec runs. SortExecutionPlan can be
+		 * overridden for other orders */
+		Spec::EExecutionOrder ExecutionOrder = Spec::EExecutionOrder::Declaration;
+
+		/* Whether or not waits on world time use virtual time. While a latent block that called
+		 * WaitOnWorldTime waits, or a coroutine block awaits a delay or ticks, time advances by
+		 * VirtualTimeStep as many times per frame as MaxVirtualStepsPerFrame allows, instead of with
+		 * real time. The test world ticks along and timeouts of latent blocks follow it.
+		 * Other waits, and async blocks, use real time */
+		bool bUseVirtualTime = false;
+		float VirtualTimeStep = 1.f / 60.f;
+		int32 MaxVirtualStepsPerFrame = 600;
+
+		/* Whether or not this spec must be defined on the game thread when specs are
+		 * defined in parallel (e.g if Define loads assets) */
+		bool bDefineOnGameThread = false;
+
+		/* Whether or not tests can be listed from the test manifest without defining the spec.
+		 * Only enable for specs whose tests can't change without rebuilding their module
+		 * (e.g not data driven) */
+		bool bCanCacheTests = false;
+
+	private:
+		using FScopeChain = TArray<int32, TInlineAllocator<16>>;
+
+		// Unique descriptions of all Describe and It blocks
+		TArray<FString> Names;
+
+		// Name indices by the hash of the name. Only used while defining
+		TMultiMap<uint32, int32> NameHashToNameMap;
+
+		// Specs in declaration order
+		TArray<FSpec> Specs;
+
+		// Spec indices by the hash of their id
+		TMultiMap<uint32, int32> IdHashToSpecMap;
+
+		// Spec indices in the order they run when the whole spec runs
+		TArray<int32> ExecutionPlan;
+
+		// All scopes, starting with the root. Parents always come before their children
+		TArray<FScope> Scopes;
+
+		// BeforeEach and AfterEach blocks of all scopes
+		TArray<Spec::FBlock> Blocks;
+
+		// Holds what is only needed while defining. Released at once after baking
+		FMemStackBase DefinitionMemory;
+
+		// Blocks in the order they were defined. Laid out into Blocks when baking
+		FDefinedBlock* FirstDefinedBlock = nullptr;
+		FDefinedBlock* LastDefinedBlock = nullptr;
+
+		TArray<int32> ScopeStack;
+
+		bool bHasBeenDefined = false;
+
+		// Whether the last RunTest left commands in the latent queue
+		bool bLastRunQueued = false;
+
+		// Seconds of virtual time elapsed, if used
+		double VirtualTime = 0.0;
+
+		// Whether the latent block being started called WaitOnWorldTime
+		bool bWaitingOnWorldTime = false;
+
+		// Whether blocks being defined keep the spec's per-test state
+		bool bDefiningInternalBlocks = false;
+
+		// Events of the async block or parallel test running on this thread, if any
+		static inline thread_local Spec::FEventSink* EventSink = nullptr;
+
+		// Context of the parallel test running on this thread, if any
+		static inline thread_local const Spec::FContext* ParallelContext = nullptr;
+
+		int32 TestsRemaining = 0;
+
+		// The context of the active test
+		Spec::FContext CurrentContext;
+
+		Spec::FStats Stats;
+
+		friend Commands::FUntilDoneLatent;
+		friend Commands::FCompositeLatent;
+		friend Commands::FAsyncLatentBase;
+		friend Commands::FCoroutineLatent;
+		template <typename TParent>
+		friend class TCoroutineSpec;
+		friend Spec::FRegister;
+
+	public:
+		FTestSpecBase() : FAutomationTestBase("", false)
+		{
+			Scopes.AddDefaulted();
+			ScopeStack.Push(0);
+		}
+
+		virtual ~FTestSpecBase() {}
+
+		virtual bool RunTest(const FString& InParameters) override;
+
+		virtual bool IsStressTest() const
+		{
+			return false;
+		}
+		virtual uint32 GetRequiredDeviceNum() const override
+		{
+			return 1;
+		}
+
+		virtual FString GetTestSourceFileName() const override;
+		virtual int32 GetTestSourceFileLine() const override;
+		virtual FString GetTestSourceFileName(const FString& InTestName) const override;
+		virtual int32 GetTestSourceFileLine(const FString& InTestName) const override;
+
+		virtual void GetTests(
+			TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const override;
+
+		// Events of async blocks and of tests running in parallel go to a sink while on workers,
+		// to be reported in order on the game thread
+		virtual void AddError(const FString& InError, int32 StackOffset = 0) override
+		{
+			if (EventSink)
+			{
+				EventSink->Add(Spec::FEventSink::EType::Error, InError);
+				return;
+			}
+			FAutomationTestBase::AddError(InError, StackOffset + 1);
+		}
+		virtual void AddWarning(const FString& InWarning, int32 StackOffset = 0) override
+		{
+			if (EventSink)
+			{
+				EventSink->Add(Spec::FEventSink::EType::Warning, InWarning);
+				return;
+			}
+			FAutomationTestBase::AddWarning(InWarning, StackOffset + 1);
+		}
+		virtual void AddInfo(
+			const FString& InLogItem, int32 StackOffset = 0, bool bCaptureStack = false) override
+		{
+			if (EventSink)
+			{
+				EventSink->Add(Spec::FEventSink::EType::Info, InLogItem);
+				return;
+			}
+			FAutomationTestBase::AddInfo(InLogItem, StackOffset + 1, bCaptureStack);
+		}
+
+		// @return whether the running test has errors. Only its own when tests run in parallel
+		bool HasTestErrors() const
+		{
+			return EventSink ? EventSink->HasErrors() : HasAnyErrors();
+		}
+
+		// BEGIN Enabled Scopes
+		void Describe(const FString& InDescription, TFunctionRef<void()> DoWork);
+
+		void It(const FString& InDescription, Spec::FBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{
+			AddIt(InDescription, Location,
+				Spec::FBlock{MakeShared<Commands::FSingleExecuteLatent>(
+					*this, MoveTemp(DoWork), bEnableSkipIfError)});
+		}
+
+		void It(const FString& InDescription, Spec::FAsyncExecution Execution, const FTimespan& Timeout,
+			Spec::FAsyncBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{
+			AddIt(InDescription, Location,
+				Spec::FBlock{MakeShared<Commands::FAsyncLatent>(
+								 *this, Execution, MoveTemp(DoWork), Timeout, bEnableSkipIfError),
+					TEXT("async It")});
+		}
+
+		void It(const FString& InDescription, Spec::FAsyncExecution Execution,
+			Spec::FAsyncBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{
+			It(InDescription, Execution, DefaultTimeout, MoveTemp(DoWork), Location);
+		}
+
+		void LatentIt(const FString& InDescription, const FTimespan& Timeout,
+			Spec::FLatentBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{
+			AddIt(InDescription, Location,
+				Spec::FBlock{MakeShared<Commands::FUntilDoneLatent>(
+								 *this, MoveTemp(DoWork), Timeout, bEnableSkipIfError),
+					TEXT("LatentIt")});
+		}
+
+		void LatentIt(const FString& InDescription, Spec::FLatentBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{
+			LatentIt(InDescription, DefaultTimeout, MoveTemp(DoWork), Location);
+		}
+
+		void LatentIt(const FString& InDescription, Spec::FAsyncExecution Execution, const FTimespan& Timeout,
+			Spec::FAsyncLatentBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{
+			AddIt(InDescription, Location,
+				Spec::FBlock{MakeShared<Commands::FAsyncUntilDoneLatent>(
+								 *this, Execution, MoveTemp(DoWork), Timeout, bEnableSkipIfError),
+					TEXT("async LatentIt")});
+		}
+
+		void LatentIt(const FString& InDescription, Spec::FAsyncExecution Execution,
+			Spec::FAsyncLatentBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{
+			LatentIt(InDescription, Execution, DefaultTimeout, MoveTemp(DoWork), Location);
+		}
+
+		void BeforeEach(Spec::FBlockFunction DoWork)
+		{
+			AddBeforeEach(Spec::FBlock{MakeShared<Commands::FSingleExecuteLatent>(
+				*this, MoveTemp(DoWork), bEnableSkipIfError)});
+		}
+
+		void BeforeEach(
+			Spec::FAsyncExecution Execution, const FTimespan& Timeout, Spec::FAsyncBlockFunction DoWork)
+		{
+			AddBeforeEach(Spec::FBlock{
+				MakeShared<Commands::FAsyncLatent>(
+					*this, Execution, MoveTemp(DoWork), Timeout, bEnableSkipIfError),
+				TEXT("async BeforeEach")});
+		}
+
+		void BeforeEach(Spec::FAsyncExecution Execution, Spec::FAsyncBlockFunction DoWork)
+		{
+			BeforeEach(Execution, DefaultTimeout, MoveTemp(DoWork));
+		}
+
+		void LatentBeforeEach(const FTimespan& Timeout, Spec::FLatentBlockFunction DoWork)
+		{
+			AddBeforeEach(Spec::FBlock{
+				MakeShared<Commands::FUntilDoneLatent>(*this, MoveTemp(DoWork), Timeout, bEnableSkipIfError),
+				TEXT("LatentBeforeEach")});
+		}
+
+		void LatentBeforeEach(Spec::FLatentBlockFunction DoWork)
+		{
+			LatentBeforeEach(DefaultTimeout, MoveTemp(DoWork));
+		}
+
+		void LatentBeforeEach(
+			Spec::FAsyncExecution Execution, const FTimespan& Timeout, Spec::FAsyncLatentBlockFunction DoWork)
+		{
+			AddBeforeEach(Spec::FBlock{
+				MakeShared<Commands::FAsyncUntilDoneLatent>(
+					*this, Execution, MoveTemp(DoWork), Timeout, bEnableSkipIfError),
+				TEXT("async LatentBeforeEach")});
+		}
+
+		void LatentBeforeEach(Spec::FAsyncExecution Execution, Spec::FAsyncLatentBlockFunction DoWork)
+		{
+			LatentBeforeEach(Execution, DefaultTimeout, MoveTemp(DoWork));
+		}
+
+		void AfterEach(Spec::FBlockFunction DoWork)
+		{
+			AddAfterEach(Spec::FBlock{MakeShared<Commands::FSingleExecuteLatent>(*this, MoveTemp(DoWork))});
+		}
+
+		void AfterEach(
+			Spec::FAsyncExecution Execution, const FTimespan& Timeout, Spec::FAsyncBlockFunction DoWork)
+		{
+			AddAfterEach(Spec::FBlock{
+				MakeShared<Commands::FAsyncLatent>(*this, Execution, MoveTemp(DoWork), Timeout),
+				TEXT("async AfterEach")});
+		}
+
+		void AfterEach(Spec::FAsyncExecution Execution, Spec::FAsyncBlockFunction DoWork)
+		{
+			AfterEach(Execution, DefaultTimeout, MoveTemp(DoWork));
+		}
+
+		void LatentAfterEach(const FTimespan& Timeout, Spec::FLatentBlockFunction DoWork)
+		{
+			AddAfterEach(Spec::FBlock{
+				MakeShared<Commands::FUntilDoneLatent>(*this, MoveTemp(DoWork), Timeout),
+				TEXT("LatentAfterEach")});
+		}
+
+		void LatentAfterEach(Spec::FLatentBlockFunction DoWork)
+		{
+			LatentAfterEach(DefaultTimeout, MoveTemp(DoWork));
+		}
+
+		void LatentAfterEach(
+			Spec::FAsyncExecution Execution, const FTimespan& Timeout, Spec::FAsyncLatentBlockFunction DoWork)
+		{
+			AddAfterEach(Spec::FBlock{
+				MakeShared<Commands::FAsyncUntilDoneLatent>(*this, Execution, MoveTemp(DoWork), Timeout),
+				TEXT("async LatentAfterEach")});
+		}
+
+		void LatentAfterEach(Spec::FAsyncExecution Execution, Spec::FAsyncLatentBlockFunction DoWork)
+		{
+			LatentAfterEach(Execution, DefaultTimeout, MoveTemp(DoWork));
+		}
+
+		// END Enabled Scopes
+
+		// BEGIN Disabled Scopes
+		void xDescribe(const FString& InDescription, TFunctionRef<void()> DoWork) {}
+
+		void xIt(const FString& InDescription, Spec::FBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{}
+		void xIt(const FString& InDescription, Spec::FAsyncExecution Execution,
+			Spec::FAsyncBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{}
+		void xIt(const FString& InDescription, Spec::FAsyncExecution Execution, const FTimespan& Timeout,
+			Spec::FAsyncBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{}
+
+		void xLatentIt(const FString& InDescription, Spec::FLatentBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{}
+		void xLatentIt(const FString& InDescription, const FTimespan& Timeout,
+			Spec::FLatentBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{}
+		void xLatentIt(const FString& InDescription, Spec::FAsyncExecution Execution,
+			Spec::FAsyncLatentBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{}
+		void xLatentIt(const FString& InDescription, Spec::FAsyncExecution Execution,
+			const FTimespan& Timeout, Spec::FAsyncLatentBlockFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{}
+
+		void xBeforeEach(Spec::FBlockFunction DoWork) {}
+		void xBeforeEach(Spec::FAsyncExecution Execution, Spec::FAsyncBlockFunction DoWork) {}
+		void xBeforeEach(
+			Spec::FAsyncExecution Execution, const FTimespan& Timeout, Spec::FAsyncBlockFunction DoWork)
+		{}
+
+		void xLatentBeforeEach(Spec::FLatentBlockFunction DoWork) {}
+		void xLatentBeforeEach(const FTimespan& Timeout, Spec::FLatentBlockFunction DoWork) {}
+		void xLatentBeforeEach(Spec::FAsyncExecution Execution, Spec::FAsyncLatentBlockFunction DoWork) {}
+		void xLatentBeforeEach(
+			Spec::FAsyncExecution Execution, const FTimespan& Timeout, Spec::FAsyncLatentBlockFunction DoWork)
+		{}
+
+		void xAfterEach(Spec::FBlockFunction DoWork) {}
+		void xAfterEach(Spec::FAsyncExecution Execution, Spec::FAsyncBlockFunction DoWork) {}
+		void xAfterEach(
+			Spec::FAsyncExecution Execution, const FTimespan& Timeout, Spec::FAsyncBlockFunction DoWork)
+		{}
+
+		void xLatentAfterEach(Spec::FLatentBlockFunction DoWork) {}
+		void xLatentAfterEach(const FTimespan& Timeout, Spec::FLatentBlockFunction DoWork) {}
+		void xLatentAfterEach(Spec::FAsyncExecution Execution, Spec::FAsyncLatentBlockFunction DoWork) {}
+		void xLatentAfterEach(
+			Spec::FAsyncExecution Execution, const FTimespan& Timeout, Spec::FAsyncLatentBlockFunction DoWork)
+		{}
+
+		// END Disabled Scopes
+
+		int32 GetNumTests() const
+		{
+			return Specs.Num();
+		}
+		int32 GetTestsRemaining() const
+		{
+			return GetNumTests() - GetCurrentContext().GetId();
+		}
+		Spec::FContext GetCurrentContext() const
+		{
+			return ParallelContext ? *ParallelContext : CurrentContext;
+		}
+		bool IsFirstTest() const
+		{
+			return GetCurrentContext().GetId() == 1;
+		}
+		bool IsLastTest() const
+		{
+			return GetCurrentContext().GetId() == GetNumTests();
+		}
+		const Spec::FStats& GetStats() const
+		{
+			return Stats;
+		}
+
+		// @return true if the last RunTest queued commands instead of finishing inline
+		bool WasLastRunQueued() const
+		{
+			return bLastRunQueued;
+		}
+
+		bool CanCacheTests() const
+		{
+			return bCanCacheTests;
+		}
+
+		bool UsesVirtualTime() const
+		{
+			return bUseVirtualTime;
+		}
+
+		// @return seconds of virtual time if used, or of real time otherwise
+		double GetTime() const
+		{
+			return bUseVirtualTime ? VirtualTime : FPlatformTime::Seconds();
+		}
+
+		// Advances virtual time while still waiting, until the deadline or until the steps
+		// of this frame run out
+		virtual void WarpTime(double Deadline, TFunctionRef<bool()> IsWaiting)
+		{
+			for (int32 Step = 0;
+				 Step < MaxVirtualStepsPerFrame && VirtualTime < Deadline && IsWaiting(); ++Step)
+			{
+				AdvanceVirtualTime(VirtualTimeStep);
+			}
+		}
+
+	protected:
+		void EnsureDefinitions() const;
+
+		virtual void RunDefine()
+		{
+			{
+				TGuardValue<bool> InternalGuard(bDefiningInternalBlocks, true);
+				PreDefine();
+			}
+			Define();
+			{
+				TGuardValue<bool> InternalGuard(bDefiningInternalBlocks, true);
+				PostDefine();
+			}
+		}
+		virtual void PreDefine();
+		virtual void Define() = 0;
+		virtual void PostDefine();
+
+		// @return why none of the tests of this spec can run inline, or null if they may
+		virtual const TCHAR* GetLatentReason() const
+		{
+			return nullptr;
+		}
+
+		void AdvanceVirtualTime(float DeltaTime)
+		{
+			VirtualTime += DeltaTime;
+		}
+
+		// Called by a latent block that waits on timers or world time, so that virtual time
+		// advances while it waits. Other latent blocks wait in real time
+		void WaitOnWorldTime()
+		{
+			bWaitingOnWorldTime = true;
+		}
+
+		// Runs async blocks on Automatron's worker pool
+		static Spec::FAsyncExecution WorkerPool()
+		{
+			return Spec::FAsyncExecution::WorkerPool();
+		}
+
+		// Sorts the spec indices of the execution plan following ExecutionOrder.
+		// The plan is in declaration order when received
+		virtual void SortExecutionPlan(TArray<int32>& Plan) const;
+
+		FString GetTestId(int32 SpecIndex) const;
+
+		// @return why a test can't run inline, or null if it can
+		const TCHAR* GetTestLatentReason(int32 SpecIndex) const
+		{
+			return Specs[SpecIndex].LatentReason;
+		}
+
+		// @return seconds a test took to run the last time, or 0 if it didn't run yet
+		double GetTestLastDuration(int32 SpecIndex) const
+		{
+			return Specs[SpecIndex].LastDuration;
+		}
+
+		Spec::FStats& GetMutableStats()
+		{
+			return Stats;
+		}
+
+		void BakeDefinitions();
+
+		void Redefine();
+
+	private:
+		void AddIt(const FString& InDescription, const Spec::FSourceLocation& Location, Spec::FBlock Block);
+
+		void AddBeforeEach(Spec::FBlock Block)
+		{
+			++Scopes[ScopeStack.Last()].NumBeforeEach;
+			AddDefinedBlock(MoveTemp(Block), false);
+		}
+
+		void AddAfterEach(Spec::FBlock Block)
+		{
+			++Scopes[ScopeStack.Last()].NumAfterEach;
+			AddDefinedBlock(MoveTemp(Block), true);
+		}
+
+		void AddDefinedBlock(Spec::FBlock Block, bool bAfterEach);
+
+		// Runs the spec inline if allowed and possible, or queues it otherwise
+		// @return true if the spec did run inline
+		bool RunSpec(int32 SpecIndex, bool bAllowInline);
+
+		// Runs the tests of the plan that can run inline concurrently
+		// @return the tests of the plan left to run
+		TArray<int32> RunSpecsInParallel();
+
+		// Gathers the blocks of a test in the order they run
+		void GatherBlocks(int32 SpecIndex, TArray<const Spec::FBlock*>& OutBlocks) const;
+
+		// Counts how long the latent block that was last done waited to be resumed, if any was
+		void RecordWaitLatency();
+
+		void BuildExecutionPlan();
+
+		// @return index of the name in the name table. Added if it wasn't there
+		int32 InternName(const FString& Name);
+
+		// Fills a scope and its parents, from the innermost to the root
+		void GetScopeChain(int32 ScopeIndex, FScopeChain& OutChain) const;
+
+		// Appends the description of a spec: the names of its blocks joined by dots
+		void BuildDescription(const FSpec& Spec, FStringBuilderBase& OutDescription) const;
+
+		// Appends the id of a spec: the names of its blocks joined by spaces, or the id
+		// at the end of its description (e.g "Test [Id]")
+		void BuildId(const FSpec& Spec, FStringBuilderBase& OutId) const;
+
+		// @return index of the spec with this id, or INDEX_NONE
+		int32 FindSpecIndex(FStringView Id) const;
+
+		// @return index of the spec with this test name, with or without the spec name before it
+		int32 FindSpecIndexByTestName(const FString& InTestName) const;
+
+		// Ids are case insensitive
+		static uint32 HashId(FStringView Id);
+	};
+
+	class FTestSpec : public FTestSpecBase
+	{
+	public:
+		// Should a world be initialized for all tests? If false, Describe blocks can still call UseWorld
+		bool bUseWorld = true;
+
+		// If true the world used for testing will be reused for all tests
+		bool bReuseWorldForAllTests = true;
+
+		// If true and in editor, a PIE instance will be used to test
+		bool bCanUsePIEWorld = true;
+
+		// If true, a PIE session started by this spec is kept for the next specs instead of ended.
+		// Its world is restored to how it started between specs. PIE ends when testing ends
+		bool bKeepPIEWorld = false;
+
+		// If true, created worlds are taken from and given back to a pool shared by all specs
+		// instead of being destroyed. Worlds are restored to how they were created when given back
+		bool bUseWorldPool = false;
+
+		// If true and the world is reused, it is restored after each test to how it was before the first one.
+		// Actors spawned by the test are destroyed and the properties of the rest restored
+		bool bRestoreWorldBetweenTests = false;
+
+		FTestWorldSettings DefaultWorldSettings;
+
+		// Used by TickWorld and TickWorldUntil when no tick settings are provided
+		FTestTickSettings DefaultTickSettings;
+
+	private:
+		FString ClassName;
+		FString PrettyName;
+		FString FileName;
+		int32 LineNumber = -1;
+		uint32 Flags = 0;
+
+		bool bInitializedWorld = false;
+		bool bPooledWorld = false;
+#if WITH_EDITOR
+		bool bInitializedPIE = false;
+		FDelegateHandle PIEStartedHandle;
+#endif
+
+		TWeakObjectPtr<UWorld> MainWorld;
+
+		// The world before the first test ran, if restored between tests
+		Spec::FWorldSnapshot WorldSnapshot;
+
+	public:
+		FTestSpec() : FTestSpecBase() {}
+
+		virtual FString GetTestSourceFileName() const override
+		{
+			return FileName;
+		}
+		virtual int32 GetTestSourceFileLine() const override
+		{
+			return LineNumber;
+		}
+		virtual uint32 GetTestFlags() const override
+		{
+			return Flags;
+		}
+
+		const FString& GetClassName() const
+		{
+			return ClassName;
+		}
+		const FString& GetPrettyName() const
+		{
+			return PrettyName;
+		}
+
+	protected:
+		virtual FString GetBeautifiedTestName() const override
+		{
+			return PrettyName;
+		}
+
+		template <uint32 TFlags>
+		void Setup(FString&& InName, FString&& InPrettyName, FString&& InFileName, int32 InLineNumber,
+			bool bRegister = true);
+
+		// Used to indicate a test is pending to be implemented.
+		void TestNotImplemented()
+		{
+			AddWarning(TEXT("Test not implemented"), 1);
+		}
+
+		virtual void PreDefine() override;
+		virtual void PostDefine() override;
+
+		// Initializes a world for the tests of the current Describe and its children, when bUseWorld
+		// is false. Other tests don't wait for it. Call it before any BeforeEach that needs the world
+		void UseWorld();
+
+		virtual const TCHAR* GetLatentReason() const override
+		{
+			return bUseWorld ? TEXT("world") : nullptr;
+		}
+
+		// Ticks the test world along with DefaultTickSettings, so that its time and timers follow
+		// virtual time. Worlds the editor ticks, like PIE worlds, are left alone
+		virtual void WarpTime(double Deadline, TFunctionRef<bool()> IsWaiting) override;
+
+		void PrepareTestWorld(TFunction<void(UWorld* World)> OnWorldReady);
+
+		void ReleaseTestWorld(UWorld* World);
+
+		// Creates an empty world from scratch
+		// @return world that was created
+		UWorld* CreateWorld(FTestWorldSettings Settings = {})
+		{
+			UWorld* World = InitializeWorld(Settings);
+			BeginWorldPlay(World);
+			return World;
+		}
+
+		// Creates an empty world with its game instance and game mode, but doesn't begin play
+		// @return world that was created
+		UWorld* InitializeWorld(FTestWorldSettings Settings = {});
+
+		static void BeginWorldPlay(UWorld* World);
+
+		// Creates a world without rendering scene, physics, navigation, AI, audio or FX
+		// @return world that was created
+		static UWorld* CreateLogicOnlyWorld();
+
+		// Creates a copy of the map of the settings
+		// @return world that was created, or null if the map couldn't be loaded
+		static UWorld* CreateMapWorld(const FTestWorldSettings& Settings);
+
+		void TickWorldUntil(UWorld* World, bool bUseRealtime, TFunction<bool(float)> Delegate)
+		{
+			TickWorldUntil(World, DefaultTickSettings, bUseRealtime, MoveTemp(Delegate));
+		}
+		void TickWorldUntil(UWorld* World, const FTestTickSettings& Settings, bool bUseRealtime,
+			TFunction<bool(float)> Delegate);
+
+		void TickWorld(UWorld* World, float Duration, bool bUseRealtime = false)
+		{
+			TickWorld(World, Duration, DefaultTickSettings, bUseRealtime);
+		}
+		void TickWorld(
+			UWorld* World, float Duration, const FTestTickSettings& Settings, bool bUseRealtime = false);
+
+		UGameInstance* CreateGameInstance(const FTestWorldSettings& Settings, UObject* Context);
+
+		// Tears down a world and its game instance. Static so that worlds outliving their spec,
+		// like pooled worlds, can be destroyed without it
+		// @return false if there was no world or it is a PIE world
+		static bool DestroyWorld(UWorld* World);
+
+		UWorld* GetMainWorld() const
+		{
+			return MainWorld.Get();
+		}
+
+	private:
+		void Reregister(const FString& NewName)
+		{
+			FAutomationTestFramework::Get().UnregisterAutomationTest(TestName);
+			TestName = NewName;
+			FAutomationTestFramework::Get().RegisterAutomationTest(TestName, this);
+		}
+
+		// Adds a BeforeEach to the current scope that prepares the world
+		void AddWorldPreparation();
+
+		// Finds the first available game world (Standalone or PIE)
+		static UWorld* FindGameWorld();
+
+		static UWorld::InitializationValues GetInitializationValues(ETestWorldProfile Profile);
+
+		// Makes the game instance play in a world created by the spec instead of its own
+		static void SetWorldGameInstance(UWorld* World, UGameInstance* GameInstance);
+
+		// Where packages of copies of maps are created
+		static constexpr const TCHAR* MapCopiesPath = TEXT("/Temp/Automatron/");
+
+		// Disables the tick of actors and components filtered out by the settings.
+		// Fills the ones disabled, to enable them back after ticking
+		static void DisableFilteredTicks(UWorld* World, const FTestTickSettings& Settings,
+			TArray<TWeakObjectPtr<AActor>>& OutActors,
+			TArray<TWeakObjectPtr<UActorComponent>>& OutComponents);
+
+		static bool SetGameMode(UWorld* World, FTestWorldSettings& Settings);
+
+		friend Spec::FWorldPool;
+	};
+
+#if AUTOMATRON_COROUTINES
+	/////////////////////////////////////////////////////
+	// Adds coroutine blocks to a spec class, as in TCoroutineSpec<FTestSpec>.
+	// Spec classes themselves don't depend on whether coroutines are available,
+	// so that modules compiled with and without C++20 share the same layouts
+	template <typename TParent>
+	class TCoroutineSpec : public TParent
+	{
+	public:
+		// BEGIN Enabled Scopes
+		void CoIt(const FString& InDescription, const FTimespan& Timeout, Spec::FCoroutineFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{
+			this->AddIt(InDescription, Location,
+				Spec::FBlock{MakeShared<Commands::FCoroutineLatent>(
+								 *this, MoveTemp(DoWork), Timeout, this->bEnableSkipIfError),
+					TEXT("CoIt")});
+		}
+
+		void CoIt(const FString& InDescription, Spec::FCoroutineFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{
+			CoIt(InDescription, this->DefaultTimeout, MoveTemp(DoWork), Location);
+		}
+
+		void CoBeforeEach(const FTimespan& Timeout, Spec::FCoroutineFunction DoWork)
+		{
+			this->AddBeforeEach(Spec::FBlock{MakeShared<Commands::FCoroutineLatent>(
+												 *this, MoveTemp(DoWork), Timeout, this->bEnableSkipIfError),
+				TEXT("CoBeforeEach")});
+		}
+
+		void CoBeforeEach(Spec::FCoroutineFunction DoWork)
+		{
+			CoBeforeEach(this->DefaultTimeout, MoveTemp(DoWork));
+		}
+
+		void CoAfterEach(const FTimespan& Timeout, Spec::FCoroutineFunction DoWork)
+		{
+			this->AddAfterEach(Spec::FBlock{
+				MakeShared<Commands::FCoroutineLatent>(*this, MoveTemp(DoWork), Timeout),
+				TEXT("CoAfterEach")});
+		}
+
+		void CoAfterEach(Spec::FCoroutineFunction DoWork)
+		{
+			CoAfterEach(this->DefaultTimeout, MoveTemp(DoWork));
+		}
+		// END Enabled Scopes
+
+		// BEGIN Disabled Scopes
+		void xCoIt(const FString& InDescription, Spec::FCoroutineFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{}
+		void xCoIt(const FString& InDescription, const FTimespan& Timeout, Spec::FCoroutineFunction DoWork,
+			const Spec::FSourceLocation& Location = Spec::FSourceLocation::Current())
+		{}
+
+		void xCoBeforeEach(Spec::FCoroutineFunction DoWork) {}
+		void xCoBeforeEach(const FTimespan& Timeout, Spec::FCoroutineFunction DoWork) {}
+
+		void xCoAfterEach(Spec::FCoroutineFunction DoWork) {}
+		void xCoAfterEach(const FTimespan& Timeout, Spec::FCoroutineFunction DoWork) {}
+		// END Disabled Scopes
+
+	protected:
+		// What coroutine blocks can co_await
+		static Spec::FTicksAwaitable NextTick()
+		{
+			return Spec::FTicksAwaitable{1};
+		}
+		static Spec::FTicksAwaitable WaitTicks(int32 NumTicks)
+		{
+			return Spec::FTicksAwaitable{NumTicks};
+		}
+		static Spec::FDelayAwaitable Wait(const FTimespan& Duration)
+		{
+			return Spec::FDelayAwaitable{Duration};
+		}
+		static Spec::FConditionAwaitable WaitUntil(TFunction<bool()> Condition)
+		{
+			return Spec::FConditionAwaitable{MoveTemp(Condition)};
+		}
+		static Spec::FDoneAwaitable WaitUntilDone(Spec::FLatentBlockFunction DoWork)
+		{
+			return Spec::FDoneAwaitable{MoveTemp(DoWork)};
+		}
+		template <typename T>
+		static Spec::TFutureAwaitable<T> WaitFor(TFuture<T>&& Future)
+		{
+			return Spec::TFutureAwaitable<T>{MoveTemp(Future)};
+		}
+		// Waits for a delegate that outlives the test, like engine delegates
+		template <typename TDelegate>
+		static Spec::TEventAwaitable<TDelegate> WaitForEvent(TDelegate& Delegate)
+		{
+			return Spec::TEventAwaitable<TDelegate>{Delegate};
+		}
+		// Waits for a delegate of an object the test may destroy, like an actor or component
+		template <typename TDelegate>
+		static Spec::TEventAwaitable<TDelegate> WaitForEvent(const UObject* Owner, TDelegate& Delegate)
+		{
+			return Spec::TEventAwaitable<TDelegate>{Delegate, Owner};
+		}
+	};
+#endif
+
+	namespace Spec
+	{
+		/////////////////////////////////////////////////////
+		// Tests of lazy specs saved to disk, so that they are listed without defining their specs.
+		// Each module has its own file, loaded memory-mapped when one of its specs is first listed.
+		// The file of a module is ignored once the module binary changes
+		class FManifest
+		{
+		public:
+			struct FTest
+			{
+				FString Id;
+				FString Description;
+				FString FileName;
+				int32 LineNumber = 0;
+
+				friend FArchive& operator<<(FArchive& Ar, FTest& Test)
+				{
+					return Ar << Test.Id << Test.Description << Test.FileName << Test.LineNumber;
+				}
+			};
+
+		private:
+			static constexpr uint32 Magic = 0x4E544D41;
+			static constexpr int32 Version = 2;
+
+			struct FModuleFile
+			{
+				FString Path;
+
+				// Identifies the module binary the records were saved for. Empty if it wasn't found
+				FString Stamp;
+
+				TUniquePtr<IMappedFileHandle> MappedFile;
+				TUniquePtr<IMappedFileRegion> MappedRegion;
+
+				// Offset and size of the record of each spec class in the mapped file
+				TMap<FString, TPair<int64, int64>> MappedRecords;
+
+				// Records added since the file was last saved
+				TMap<FString, TArray<uint8>> NewRecords;
+			};
+
+			const FString Directory;
+
+			TMap<FString, FModuleFile> Modules;
+
+		public:
+			explicit FManifest(const FString& InDirectory) : Directory(InDirectory) {}
+
+			static AUTOMATRON_API FManifest& Get();
+
+			// @return true if there is a record of the spec for the current binary of its module.
+			// bOutCacheable is false if the spec doesn't allow listing its tests from the manifest
+			bool FindTests(const FSpecInfo& Info, TArray<FTest>& OutTests, bool& bOutCacheable);
+
+			// Records the tests of a spec, or that they can't be cached if Tests is null
+			void AddTests(const FSpecInfo& Info, TArray<FTest>* Tests);
+
+			// Writes new records to disk, keeping the records of other specs of the same module already there
+			void Save();
+
+		private:
+			FManifest();
+
+			// @return the file of the module of an spec, loading it the first time.
+			// Null if the spec has no module or its binary wasn't found
+			FModuleFile* FindModuleFile(const FSpecInfo& Info);
+
+			void LoadFile(FModuleFile& File);
+			void UnloadFile(FModuleFile& File);
+			void SaveFile(FModuleFile& File);
+
+			// @return a stamp of the binary a module was loaded from, or an empty string if it wasn't found
+			static FString GetModuleStamp(const ANSICHAR* ModuleName);
+
+			static bool ReadRecord(
+				const uint8* Data, int64 Size, TArray<FTest>& OutTests, bool& bOutCacheable);
+
+			// Calls Visitor with the class name, offset and size of each record in a manifest file
+			// saved for this stamp
+			static void VisitRecords(const uint8* Data, int64 Size, const FString& Stamp,
+				TFunctionRef<void(const FString& ClassName, int64 Offset, int64 Size)> Visitor);
+		};
+
+		/////////////////////////////////////////////////////
+		// Worlds created by specs, kept when released so that specs with the same world settings
+		// don't create their own. Idle worlds are destroyed when testing ends
+		class FWorldPool
+		{
+			struct FPooledWorld
+			{
+				FTestWorldSettings Settings;
+				TWeakObjectPtr<UWorld> World;
+
+				// The world once created, restored when the world is released
+				FWorldSnapshot Snapshot;
+
+				bool bInUse = false;
+
+				// When it was last released, used to destroy the least recently used worlds first
+				uint64 LastRelease = 0;
+			};
+
+			TArray<FPooledWorld> Worlds;
+			uint64 NumReleases = 0;
+
+		public:
+			// Idle worlds kept at most
+			int32 MaxIdleWorlds = 8;
+
+			static AUTOMATRON_API FWorldPool& Get();
+
+			// @return an idle world with these settings, or a new world created by the spec
+			UWorld* Acquire(FTestSpec& Spec, const FTestWorldSettings& Settings);
+
+			// Resets a world acquired from this pool and makes it available again
+			// @return false if the world is not from this pool
+			bool Release(UWorld* World);
+
+			// Destroys all idle worlds
+			void Empty();
+
+			int32 GetNumWorlds() const
+			{
+				return Worlds.Num();
+			}
+
+			// @return true if the world was created for this pool, idle or not
+			bool Owns(const UWorld* World) const
+			{
+				return Worlds.ContainsByPredicate([World](const FPooledWorld& Pooled) {
+					return Pooled.World.Get() == World;
+				});
+			}
+
+			// @return true if the world was acquired from this pool and not released yet
+			bool IsInUse(const UWorld* World) const
+			{
+				return Worlds.ContainsByPredicate([World](const FPooledWorld& Pooled) {
+					return Pooled.bInUse && Pooled.World.Get() == World;
+				});
+			}
+
+		private:
+			FWorldPool()
+			{
+				FAutomationTestFramework::Get().PostTestingEvent.AddRaw(this, &FWorldPool::Empty);
+			}
+
+			void DestroyLeastRecentlyUsed();
+		};
+
+		/////////////////////////////////////////////////////
+		// Maps loaded once and kept loaded until testing ends, so that tests get copies of them
+		// without loading them again
+		class FMapCache
+		{
+			// Loaded maps by package name
+			TMap<FString, TWeakObjectPtr<UWorld>> Maps;
+
+		public:
+			static AUTOMATRON_API FMapCache& Get();
+
+			// @return the map, loaded if it wasn't, or null if it couldn't be loaded
+			UWorld* Load(const TSoftObjectPtr<UWorld>& Map);
+
+			// Lets all maps be unloaded
+			void Empty();
+
+		private:
+			FMapCache()
+			{
+				FAutomationTestFramework::Get().PostTestingEvent.AddRaw(this, &FMapCache::Empty);
+			}
+		};
+
+#if WITH_EDITOR
+		/////////////////////////////////////////////////////
+		// A PIE session kept between specs, so that each of them doesn't start its own.
+		// Ended when testing ends
+		class FPersistentPIE
+		{
+			// The PIE world as it started
+			FWorldSnapshot Snapshot;
+
+		public:
+			static AUTOMATRON_API FPersistentPIE& Get();
+
+			// Keeps the PIE session of this world until testing ends
+			void Keep(UWorld* World)
+			{
+				Snapshot.Capture(World);
+			}
+
+			bool Owns(const UWorld* World) const
+			{
+				return World && Snapshot.GetWorld() == World;
+			}
+
+			// Restores the world to how it was when PIE started
+			// @return false if the world couldn't be restored, and should not be used again
+			bool Restore()
+			{
+				return Snapshot.Restore();
+			}
+
+			// Ends the kept PIE session, if any
+			void End();
+
+		private:
+			FPersistentPIE()
+			{
+				FAutomationTestFramework::Get().PostTestingEvent.AddRaw(this, &FPersistentPIE::End);
+			}
+		};
+#endif
+
+		/////////////////////////////////////////////////////
+		// Registered to the framework in place of an spec. Constructs the spec
+		// the first time its tests are listed or run, and reports as the spec
+		class FLazySpec : public FAutomationTestBase
+		{
+		public:
+			using FFactory = FTestSpec* (*)();
+
+		private:
+			const FSpecInfo Info;
+			const FFactory Factory;
+
+			mutable TUniquePtr<FTestSpec> Spec;
+
+			// Tests read from the manifest. Used until the spec is constructed
+			mutable TArray<FManifest::FTest> ManifestTests;
+			mutable bool bReadManifest = false;
+			mutable bool bInManifest = false;
+			mutable bool bCacheable = false;
+
+		public:
+			FLazySpec(const FSpecInfo& InInfo, FFactory InFactory)
+				: FAutomationTestBase(InInfo.ClassName, false)
+				, Info(InInfo)
+				, Factory(InFactory)
+			{}
+
+			virtual bool RunTest(const FString& InParameters) override;
+
+			virtual uint32 GetTestFlags() const override
+			{
+				return Info.Flags;
+			}
+			virtual uint32 GetRequiredDeviceNum() const override
+			{
+				return 1;
+			}
+
+			virtual FString GetTestSourceFileName() const override
+			{
+				return FString(Info.FileName);
+			}
+			virtual int32 GetTestSourceFileLine() const override
+			{
+				return Info.LineNumber;
+			}
+			virtual FString GetTestSourceFileName(const FString& InTestName) const override;
+			virtual int32 GetTestSourceFileLine(const FString& InTestName) const override;
+
+			virtual void GetTests(
+				TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const override;
+
+			// Errors and warnings captured from the log go to the spec,
+			// so that they are checked against the errors it expects
+			virtual void AddError(const FString& InError, int32 StackOffset = 0) override;
+			virtual void AddWarning(const FString& InWarning, int32 StackOffset = 0) override;
+
+			bool IsSpecConstructed() const
+			{
+				return Spec.IsValid();
+			}
+
+			// @return the spec to define before its tests are listed, or null if listed from the manifest
+			FTestSpec* GetSpecToDefine() const
+			{
+				return UseManifest() ? nullptr : &GetSpec();
+			}
+
+		protected:
+			virtual FString GetBeautifiedTestName() const override
+			{
+				return Info.PrettyName;
+			}
+
+		private:
+			FTestSpec& GetSpec() const;
+
+			// @return true if tests are listed from the manifest
+			bool UseManifest() const;
+
+			// @return the test with this test name in the manifest, or null
+			const FManifest::FTest* FindManifestTest(const FString& InTestName) const;
+
+			// Saves the tests listed by the spec to the manifest
+			void AddToManifest(const TArray<FString>& BeautifiedNames, const TArray<FString>& TestCommands,
+				int32 FirstTest) const;
+
+			// Reports the events of the last run of the spec as events of this entry
+			void ForwardEvents();
+		};
+
+		template <typename T>
+		TRegister<T> TRegister<T>::Instance{};
+
+		template <typename T>
+		inline void TRegister<T>::Setup()
+		{
+#if AUTOMATRON_LAZY_SPECS
+			static FLazySpec Entry{T::__meta_info(), &TRegister<T>::Create};
+			Entries().Add(&Entry);
+#else
+			static T Spec{};
+			Spec.Setup();
+			Entries().Add(&Spec);
+#endif
+		}
+
+		template <typename T>
+		inline FTestSpec* TRegister<T>::Create()
+		{
+			T* Spec = new T{};
+			Spec->Setup(false);
+			return Spec;
+		}
+	}	 // namespace Spec
+
+	static void RegisterSpecs()
+	{
+		Spec::FRegister::OnSetup().Broadcast();
+	}
+
+	// Optionally called after RegisterSpecs, so that listing tests doesn't define specs one by one
+	static void DefineSpecsInParallel()
+	{
+		Spec::FRegister::DefineSpecsInParallel();
+	}
+}	 // namespace Automatron
+
+
+////////////////////////////////////////////////////////////////
+// GENERATION MACROS
+
+#define GENERATE_SPEC(TClass, PrettyName, TFlags) \
+	GENERATE_SPEC_PRIVATE(TClass, PrettyName, TFlags, __FILE__, __LINE__)
+
+#define GENERATE_SPEC_PRIVATE(TClass, PrettyName, TFlags, FileName, LineNumber)          \
+private:                                                                                 \
+	void Setup(bool bRegister = true)                                                    \
+	{                                                                                    \
+		FTestSpec::Setup<TFlags>(                                                        \
+			TEXT(#TClass), TEXT(PrettyName), FileName, LineNumber, bRegister);           \
+	}                                                                                    \
+	static Automatron::Spec::FSpecInfo __meta_info()                                     \
+	{                                                                                    \
+		return {TEXT(#TClass), TEXT(PrettyName), FileName, LineNumber, TFlags,           \
+			AUTOMATRON_MODULE_NAME};                                                     \
+	}                                                                                    \
+	static Automatron::Spec::TRegister<TClass>& __meta_register()                        \
+	{                                                                                    \
+		return Automatron::Spec::TRegister<TClass>::Instance;                            \
+	}                                                                                    \
+	friend Automatron::Spec::TRegister<TClass>;                                          \
+                                                                                         \
+	virtual void Define() override
+
+#define SPEC(TClass, TParent, PrettyName, TFlags)  \
+	class TClass : public TParent                  \
+	{                                              \
+		GENERATE_SPEC(TClass, PrettyName, TFlags); \
+	};                                             \
+	void TClass::Define()
+
+
+////////////////////////////////////////////////////////////////
+// DECLARATIONS
+
+namespace Automatron
+{
+	namespace Commands
+	{
+		inline bool FSingleExecuteLatent::Update()
+		{
+			if (bSkipIfErrored && Spec.HasTestErrors())
+			{
+				return true;
+			}
+
+			Predicate();
+			return true;
+		}
+
+		inline bool FUntilDoneLatent::Update()
+		{
+			if (!bIsRunning)
+			{
+				if (bSkipIfErrored && Spec.HasTestErrors())
+				{
+					return true;
+				}
+
+				Spec.bWaitingOnWorldTime = false;
+				Predicate(FDoneDelegate::CreateSP(this, &FUntilDoneLatent::Done));
+				bWarpsTime = Spec.UsesVirtualTime() && Spec.bWaitingOnWorldTime;
+				Spec.bWaitingOnWorldTime = false;
+
+				bIsRunning = true;
+				StartedRunning = GetTime();
+			}
+
+			const double Deadline = StartedRunning + Timeout.GetTotalSeconds();
+			if (bWarpsTime)
+			{
+				// Only waiting on world time, so it can run as fast as possible
+				Spec.WarpTime(Deadline, [this]() {
+					return !bDone;
+				});
+			}
+
+			if (bDone)
+			{
+				Reset();
+				return true;
+			}
+			else if (GetTime() >= Deadline)
+			{
+				Reset();
+				Spec.AddError(TEXT("Latent command timed out."), 0);
+				return true;
+			}
+
+			return false;
+		}
+
+		inline double FUntilDoneLatent::GetTime() const
+		{
+			return bWarpsTime ? Spec.GetTime() : FPlatformTime::Seconds();
+		}
+
+		inline void FUntilDoneLatent::Reset()
+		{
+			// Reset the done for the next potential run of this command
+			bDone = false;
+			bIsRunning = false;
+			bWarpsTime = false;
+		}
+
+		inline bool FAsyncLatentBase::Update()
+		{
+			if (!Run.IsValid())
+			{
+				if (bSkipIfErrored && Spec.HasTestErrors())
+				{
+					return true;
+				}
+
+				if (PreviousRun.IsValid() && PreviousRun->bWorkerRunning)
+				{
+					// A worker done with its block only needs to return, but a canceled one may never
+					if (PreviousRun->Token.IsCanceled())
+					{
+						Spec.AddError(TEXT("Latent command can't run while its worker from a previous "
+										   "test is still running."),
+							0);
+						return true;
+					}
+					return false;
+				}
+				PreviousRun.Reset();
+
+				const TSharedRef<Spec::FAsyncRun> NewRun =
+					MakeShared<Spec::FAsyncRun>(Spec, Spec.HasTestErrors());
+				NewRun->Block = MakeBlock();
+				// Async blocks do work instead of waiting, so they time out in real time
+				NewRun->StartTime = FPlatformTime::Seconds();
+				Run = NewRun;
+				Future = Spec::FStuckWorkers::Get().Reroute(Execution).Launch([NewRun]() {
+					RunOnWorker(*NewRun);
+				});
+			}
+
+			// Reported as they come, while still attributed to this test
+			Run->Events.Flush(Spec);
+
+			if (!Run->Token.IsCanceled())
+			{
+				if (Run->bDone)
+				{
+					Reset();
+					return true;
+				}
+
+				const double Now = FPlatformTime::Seconds();
+				if (Now < Run->StartTime + Timeout.GetTotalSeconds())
+				{
+					return false;
+				}
+				Run->Token.Cancel();
+				Run->CancelTime = Now;
+			}
+
+			// Canceled, so the worker only needs to stop
+			if (Run->bDone || Future.IsReady())
+			{
+				Reset();
+				Spec.AddError(TEXT("Latent command timed out."), 0);
+				return true;
+			}
+			else if (FPlatformTime::Seconds() >= Run->CancelTime + Spec.AsyncGracePeriod.GetTotalSeconds())
+			{
+				Spec::FStuckWorkers::Get().Add(Spec.GetTestName(), MoveTemp(Future));
+				Reset();
+				Spec.AddError(TEXT("Latent command timed out and its worker didn't stop when canceled."), 0);
+				return true;
+			}
+			return false;
+		}
+
+		inline void FAsyncLatentBase::Reset()
+		{
+			Run->Events.Flush(Spec);
+
+			// A worker that is still running keeps its own run, so it can't affect the next one
+			Run->bAbandoned = true;
+			if (Run->bWorkerRunning)
+			{
+				PreviousRun = Run;
+			}
+			Run.Reset();
+			Future = TFuture<void>();
+		}
+
+		inline void FAsyncLatentBase::RunOnWorker(Spec::FAsyncRun& InRun)
+		{
+			bool bDone = false;
+			{
+				// Blocks running on the game thread, like with TaskGraphMainThread, report in place
+				TGuardValue<Spec::FEventSink*> SinkGuard(
+					FTestSpecBase::EventSink, IsInGameThread() ? FTestSpecBase::EventSink : &InRun.Events);
+				bDone = InRun.Block(InRun);
+			}
+			InRun.bWorkerRunning = false;
+			if (bDone)
+			{
+				Done(InRun);
+			}
+		}
+
+		inline TUniqueFunction<bool(Spec::FAsyncRun&)> FAsyncUntilDoneLatent::MakeBlock() const
+		{
+			return [Predicate = Predicate](Spec::FAsyncRun& InRun) {
+				(*Predicate)(FDoneDelegate::CreateLambda([RunRef = InRun.AsShared()]() {
+					Done(*RunRef);
+				}),
+					InRun.Token);
+				return false;
+			};
+		}
 
-		/* Whether or not BeforeEach and It blocks should skip execution if the test
-		 * has already failed */
-		bool bEnableSkipIfError = true;
+		inline TUniqueFunction<bool(Spec::FAsyncRun&)> FAsyncLatent::MakeBlock() const
+		{
+			return [Predicate = Predicate](Spec::FAsyncRun& InRun) {
+				(*Predicate)(InRun.Token);
+				return true;
+			};
+		}
 
-	private:
-		TArray<FString> Description;
+#if AUTOMATRON_COROUTINES
+		inline bool FCoroutineLatent::Update()
+		{
+			if (!Coroutine.IsValid())
+			{
+				if (bSkipIfErrored && Spec.HasTestErrors())
+				{
+					return true;
+				}
 
-		TMap<FString, TSharedRef<FSpec>> IdToSpecMap;
+				Coroutine = Body();
+				Coroutine.Start(Spec);
+				StartedRunning = FPlatformTime::Seconds();
+			}
 
-		TSharedPtr<FSpecDefinitionScope> RootDefinitionScope;
+			// Continue as many times as what it awaits is ready, without waiting for another update
+			while (!Coroutine.IsDone())
+			{
+				// Awaits of world time end on their own, before the timeout in real time
+				if (Spec.UsesVirtualTime() && Coroutine.WaitsOnTime())
+				{
+					Spec.WarpTime(TNumericLimits<double>::Max(), [this]() {
+						return !Coroutine.CanResume();
+					});
+				}
 
-		TArray<TSharedRef<FSpecDefinitionScope>> DefinitionScopeStack;
+				if (!Coroutine.CanResume())
+				{
+					break;
+				}
+				Spec.RecordWaitLatency();
+				Coroutine.Resume();
+			}
 
-		bool bHasBeenDefined = false;
+			if (Coroutine.IsDone())
+			{
+				Coroutine.Reset();
+				return true;
+			}
+			else if (FPlatformTime::Seconds() >= StartedRunning + Timeout.GetTotalSeconds())
+			{
+				Coroutine.Reset();
+				Spec.AddError(TEXT("Latent command timed out."), 0);
+				return true;
+			}
+			return false;
+		}
+#endif
 
-		int32 TestsRemaining = 0;
+		inline bool FCompositeLatent::Update()
+		{
+			if (bFinished)
+			{
+				bFinished = false;
+				return true;
+			}
+			return Step();
+		}
 
-		// The context of the active test
-		Spec::FContext CurrentContext;
+		inline void FCompositeLatent::Resume()
+		{
+			check(IsInGameThread());
+			if (!bUpdating && !bFinished && Step())
+			{
+				++Spec.Stats.EarlyResumes;
+				bFinished = true;
+			}
+		}
 
-	public:
-		FTestSpecBase()
-			: FAutomationTestBase("", false)
-			, RootDefinitionScope(MakeShared<FSpecDefinitionScope>())
+		inline bool FCompositeLatent::Step()
 		{
-			DefinitionScopeStack.Push(RootDefinitionScope.ToSharedRef());
+			TGuardValue<bool> UpdatingGuard(bUpdating, true);
+
+			if (CurrentIndex == 0 && StartTime == 0.0)
+			{
+				StartTime = FPlatformTime::Seconds();
+			}
+
+			FLatentScheduler& Scheduler = FLatentScheduler::Get();
+			while (CurrentIndex < Commands.Num())
+			{
+				if (!Commands[CurrentIndex]->Update())
+				{
+					if (!bScheduled)
+					{
+						Scheduler.Schedule(Spec, StaticCastSharedRef<FCompositeLatent>(AsShared()));
+						bScheduled = true;
+					}
+					return false;
+				}
+
+				Spec.RecordWaitLatency();
+
+				// The next command starts on the same frame this one finished
+				++CurrentIndex;
+			}
+
+			Spec.Specs[SpecIndex].LastDuration = FPlatformTime::Seconds() - StartTime;
+
+			if (bScheduled)
+			{
+				Scheduler.Unschedule(Spec);
+				bScheduled = false;
+			}
+
+			// Reset for the next potential run of this command
+			CurrentIndex = 0;
+			StartTime = 0.0;
+			return true;
 		}
 
-		virtual ~FTestSpecBase() {}
+		inline void FLatentScheduler::Schedule(
+			const FTestSpecBase& Spec, const TSharedRef<FCompositeLatent>& Command)
+		{
+			FScopeLock ScopeLock(&Lock);
+			Specs.FindOrAdd(&Spec).Command = Command;
+		}
 
-		virtual bool RunTest(const FString& InParameters) override;
+		inline void FLatentScheduler::Unschedule(const FTestSpecBase& Spec)
+		{
+			FScopeLock ScopeLock(&Lock);
+			if (const FWaitingSpec* WaitingSpec = Specs.Find(&Spec))
+			{
+				NumWoken -= WaitingSpec->DoneCycles != 0;
+				Specs.Remove(&Spec);
+			}
+		}
 
-		virtual bool IsStressTest() const
+		inline void FLatentScheduler::Wake(const FTestSpecBase& Spec)
 		{
-			return false;
+			FScopeLock ScopeLock(&Lock);
+			FWaitingSpec* WaitingSpec = Specs.Find(&Spec);
+			if (WaitingSpec && WaitingSpec->DoneCycles == 0)
+			{
+				WaitingSpec->DoneCycles = FPlatformTime::Cycles64();
+				++NumWoken;
+			}
 		}
-		virtual uint32 GetRequiredDeviceNum() const override
+
+		inline double FLatentScheduler::ConsumeWaitLatency(const FTestSpecBase& Spec)
 		{
-			return 1;
+			FScopeLock ScopeLock(&Lock);
+			FWaitingSpec* WaitingSpec = Specs.Find(&Spec);
+			if (!WaitingSpec || WaitingSpec->DoneCycles == 0)
+			{
+				return -1.0;
+			}
+
+			const double Latency =
+				FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - WaitingSpec->DoneCycles);
+			WaitingSpec->DoneCycles = 0;
+			--NumWoken;
+			return Latency;
 		}
 
-		virtual FString GetTestSourceFileName() const override;
-		virtual int32 GetTestSourceFileLine() const override;
-		virtual FString GetTestSourceFileName(const FString& InTestName) const override;
-		virtual int32 GetTestSourceFileLine(const FString& InTestName) const override;
+		inline void FLatentScheduler::ResumeWoken()
+		{
+			// Blocks only run while the automation framework runs tests
+			if (!GIsAutomationTesting)
+			{
+				return;
+			}
 
-		virtual void GetTests(
-			TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const override;
+			TArray<TSharedPtr<FCompositeLatent>> Woken;
+			{
+				FScopeLock ScopeLock(&Lock);
+				if (NumWoken == 0)
+				{
+					return;
+				}
 
-		// BEGIN Enabled Scopes
-		void Describe(const FString& InDescription, TFunction<void()> DoWork);
+				for (const auto& Entry : Specs)
+				{
+					if (Entry.Value.DoneCycles != 0)
+					{
+						if (TSharedPtr<FCompositeLatent> Command = Entry.Value.Command.Pin())
+						{
+							Woken.Add(MoveTemp(Command));
+						}
+					}
+				}
+			}
+
+			// Resumed outside the lock, as commands schedule and wake specs while running
+			for (const TSharedPtr<FCompositeLatent>& Command : Woken)
+			{
+				Command->Resume();
+			}
+		}
+
+		inline void FLatentScheduler::Empty()
+		{
+			FScopeLock ScopeLock(&Lock);
+			Specs.Empty();
+			NumWoken = 0;
+		}
+	}	 // namespace Commands
+
+	inline void FTestSpecBase::RecordWaitLatency()
+	{
+		const double WaitLatency = Commands::FLatentScheduler::Get().ConsumeWaitLatency(*this);
+		if (WaitLatency >= 0.0)
+		{
+			++Stats.LatentWaits;
+			Stats.WaitLatency += WaitLatency;
+			Stats.MaxWaitLatency = FMath::Max(Stats.MaxWaitLatency, WaitLatency);
+		}
+	}
+
+#if AUTOMATRON_COROUTINES
+	namespace Spec
+	{
+		inline void WakeSpec(FTestSpecBase& Spec)
+		{
+			Commands::FLatentScheduler::Get().Wake(Spec);
+		}
+
+		inline void FCoroutine::promise_type::unhandled_exception()
+		{
+			if (Spec)
+			{
+				Spec->AddError(TEXT("Coroutine block threw an exception."), 0);
+			}
+		}
+
+		inline bool FDelayAwaitable::IsReady(FTestSpecBase& Spec) const
+		{
+			return Spec.GetTime() >= Deadline;
+		}
+
+		inline void FDelayAwaitable::OnSuspend(FTestSpecBase& Spec)
+		{
+			Deadline = Spec.GetTime() + Duration.GetTotalSeconds();
+		}
+	}	 // namespace Spec
+#endif
 
-		void It(const FString& InDescription, TFunction<void()> DoWork)
+	namespace Spec
+	{
+		inline FAsyncExecution FStuckWorkers::Reroute(const FAsyncExecution& Execution)
+		{
+			if (!Execution.IsShared() || Num() == 0)
+			{
+				return Execution;
+			}
+
+			if (!bRerouted)
+			{
+				UE_LOG(LogAutomatron, Warning,
+					TEXT("%d async block workers are stuck. Async blocks run on their own thread until "
+						 "they stop"),
+					Workers.Num());
+				bRerouted = true;
+			}
+			return EAsyncExecution::Thread;
+		}
+
+		inline TFuture<void> FWorkerPool::Launch(TUniqueFunction<void()> Work)
+		{
+			if (!Pool)
+			{
+				Pool.Reset(FQueuedThreadPool::Allocate());
+				verify(Pool->Create(NumThreads, StackSize, Priority, TEXT("AutomatronWorkerPool")));
+			}
+
+			const int32 Depth = ++QueueDepth;
+			{
+				FScopeLock ScopeLock(&StatsLock);
+				MaxQueueDepth = FMath::Max(MaxQueueDepth, Depth);
+				++NumLaunched;
+			}
+
+			const uint64 LaunchCycles = FPlatformTime::Cycles64();
+			return AsyncPool(*Pool, [this, LaunchCycles, Work = MoveTemp(Work)]() {
+				--QueueDepth;
+				const double Wait = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - LaunchCycles);
+				{
+					FScopeLock ScopeLock(&StatsLock);
+					WaitTime += Wait;
+					MaxWaitTime = FMath::Max(MaxWaitTime, Wait);
+				}
+				Work();
+			});
+		}
+
+		inline bool FWorkerPool::Configure(int32 InNumThreads, EThreadPriority InPriority, uint32 InStackSize)
+		{
+			if (Pool)
+			{
+				UE_LOG(LogAutomatron, Warning,
+					TEXT("The worker pool can't be configured while its threads exist"));
+				return false;
+			}
+
+			NumThreads = InNumThreads;
+			Priority = InPriority;
+			StackSize = InStackSize;
+			return true;
+		}
+
+		inline void FWorkerPool::Shutdown()
+		{
+			if (!Pool)
+			{
+				return;
+			}
+
+			UE_LOG(LogAutomatron, Verbose,
+				TEXT("Worker pool ran %d async blocks. They waited %.2fms on average (%.2fms at most) "
+					 "with up to %d queued"),
+				NumLaunched, GetAverageWaitTime() * 1000.0, MaxWaitTime * 1000.0, MaxQueueDepth);
+
+			if (FStuckWorkers::Get().Num() == 0)
+			{
+				Pool->Destroy();
+				Pool.Reset();
+			}
+			else
+			{
+				// Destroying the threads would wait for stuck workers forever, even on exit
+				UE_LOG(LogAutomatron, Warning,
+					TEXT("Leaking the worker pool, since workers of async blocks are stuck on it"));
+				Pool.Release();
+			}
+
+			FScopeLock ScopeLock(&StatsLock);
+			MaxQueueDepth = 0;
+			NumLaunched = 0;
+			WaitTime = 0.0;
+			MaxWaitTime = 0.0;
+		}
+
+		inline void FStuckWorkers::Report()
+		{
+			if (Num() == 0)
+			{
+				return;
+			}
+
+			for (const FWorker& Worker : Workers)
+			{
+				UE_LOG(LogAutomatron, Warning, TEXT("A worker of an async block of %s is still running"),
+					*Worker.TestName);
+			}
+		}
+	}	 // namespace Spec
+
+	inline void FTestSpecBase::EnsureDefinitions() const
+	{
+		if (!bHasBeenDefined)
+		{
+			FTestSpecBase* const This = const_cast<FTestSpecBase*>(this);
+
+			// Everything allocated from DefinitionMemory is released once baked
+			FMemMark DefinitionMark(This->DefinitionMemory);
+			This->RunDefine();
+			This->BakeDefinitions();
+		}
+	}
+
+	inline FString FTestSpecBase::GetTestSourceFileName() const
+	{
+		return FAutomationTestBase::GetTestSourceFileName();
+	}
+
+	inline int32 FTestSpecBase::GetTestSourceFileLine() const
+	{
+		return FAutomationTestBase::GetTestSourceFileLine();
+	}
+
+	inline bool FTestSpecBase::RunTest(const FString& InParameters)
+	{
+		EnsureDefinitions();
+
+		if (!InParameters.IsEmpty())
+		{
+			const int32 SpecIndex = FindSpecIndex(InParameters);
+			bLastRunQueued = SpecIndex != INDEX_NONE && !RunSpec(SpecIndex, true);
+		}
+		else
+		{
+			if (ExecutionOrder == Spec::EExecutionOrder::SlowestFirst)
+			{
+				// Durations change with every run
+				BuildExecutionPlan();
+			}
+
+			TArray<int32> ParallelPlan;
+			if (bThreadSafeTests)
+			{
+				ParallelPlan = RunSpecsInParallel();
+			}
+			const TArray<int32>& Plan = bThreadSafeTests ? ParallelPlan : ExecutionPlan;
+
+			// Once a spec is queued, the ones after it are queued too to keep their order
+			bool bAllowInline = true;
+			for (const int32 SpecIndex : Plan)
+			{
+				bAllowInline = RunSpec(SpecIndex, bAllowInline);
+			}
+			bLastRunQueued = !bAllowInline;
+		}
+
+		TestsRemaining = GetNumTests();
+		return true;
+	}
+
+	inline void FTestSpecBase::GatherBlocks(int32 SpecIndex, TArray<const Spec::FBlock*>& OutBlocks) const
+	{
+		const FSpec& Spec = Specs[SpecIndex];
+
+		FScopeChain ScopeChain;
+		GetScopeChain(Spec.Scope, ScopeChain);
+
+		// BeforeEach blocks run from the root inwards
+		for (int32 ChainIndex = ScopeChain.Num() - 1; ChainIndex >= 0; --ChainIndex)
+		{
+			const FScope& Scope = Scopes[ScopeChain[ChainIndex]];
+			for (int32 Index = 0; Index < Scope.NumBeforeEach; ++Index)
+			{
+				OutBlocks.Add(&Blocks[Scope.FirstBlock + Index]);
+			}
+		}
+
+		OutBlocks.Add(&Spec.Block);
+
+		// AfterEach blocks run from the innermost scope outwards
+		for (int32 ChainIndex = 0; ChainIndex < ScopeChain.Num(); ++ChainIndex)
 		{
-			const TSharedRef<FSpecDefinitionScope> CurrentScope = DefinitionScopeStack.Last();
-			const TArray<FProgramCounterSymbolInfo> Stack = FPlatformStackWalk::GetStack(1, 1);
+			const FScope& Scope = Scopes[ScopeChain[ChainIndex]];
+			const int32 FirstAfterEach = Scope.FirstBlock + Scope.NumBeforeEach;
+			for (int32 Index = 0; Index < Scope.NumAfterEach; ++Index)
+			{
+				OutBlocks.Add(&Blocks[FirstAfterEach + Index]);
+			}
+		}
+	}
 
-			PushDescription(InDescription);
-			auto Command = MakeShared<Commands::FSingleExecuteLatent>(*this, DoWork, bEnableSkipIfError);
-			CurrentScope->It.Push(MakeShared<Spec::FIt>(
-				GetDescription(), GetId(), Stack[0].Filename, Stack[0].LineNumber, Command));
-			PopDescription(InDescription);
+	inline TArray<int32> FTestSpecBase::RunSpecsInParallel()
+	{
+		TArray<int32> Remaining;
+		TArray<int32> Parallel;
+		TArray<const Spec::FBlock*> SpecBlocks;
+		for (const int32 SpecIndex : ExecutionPlan)
+		{
+			SpecBlocks.Reset();
+			GatherBlocks(SpecIndex, SpecBlocks);
+
+			// BeforeEach and AfterEach commands are shared by the tests of their scope, and the
+			// members they set up would be too
+			const Spec::FBlock* const ItBlock = &Specs[SpecIndex].Block;
+			const bool bSharesBlocks = SpecBlocks.ContainsByPredicate([ItBlock](const Spec::FBlock* Block) {
+				return !Block->bInternal && Block != ItBlock;
+			});
+			(Specs[SpecIndex].LatentReason || bSharesBlocks ? Remaining : Parallel).Add(SpecIndex);
+		}
+		if (Parallel.Num() < 2 || GetLatentReason())
+		{
+			return ExecutionPlan;
 		}
 
-		void It(const FString& InDescription, EAsyncExecution Execution, const FTimespan& Timeout,
-			TFunction<void()> DoWork)
+		struct FParallelTest
 		{
-			const TSharedRef<FSpecDefinitionScope> CurrentScope = DefinitionScopeStack.Last();
-			const TArray<FProgramCounterSymbolInfo> Stack = FPlatformStackWalk::GetStack(1, 1);
+			TArray<const Spec::FBlock*> Blocks;
+			// Sinks can't be relocated while workers add to them
+			TUniquePtr<Spec::FEventSink> Events = MakeUnique<Spec::FEventSink>();
 
-			PushDescription(InDescription);
-			auto Command =
-				MakeShared<Commands::FAsyncLatent>(*this, Execution, DoWork, Timeout, bEnableSkipIfError);
-			CurrentScope->It.Push(MakeShared<Spec::FIt>(
-				GetDescription(), GetId(), Stack[0].Filename, Stack[0].LineNumber, Command));
-			PopDescription(InDescription);
+			// The context internal blocks give it later, seen by its blocks on the worker
+			Spec::FContext Context;
+		};
+		TArray<FParallelTest> Tests;
+		Tests.SetNum(Parallel.Num());
+		Spec::FContext Context = CurrentContext;
+		for (int32 Index = 0; Index < Parallel.Num(); ++Index)
+		{
+			GatherBlocks(Parallel[Index], Tests[Index].Blocks);
+			Context = Context.NextContext();
+			Tests[Index].Context = Context;
 		}
 
-		void It(const FString& InDescription, EAsyncExecution Execution, TFunction<void()> DoWork)
+		// Only synchronous tests run in parallel, but a command that waits anyway fails its test
+		// instead of asserting
+		const auto UpdateBlock = [this](const Spec::FBlock& Block) {
+			if (!Block.Command->Update())
+			{
+				AddError(TEXT("Block of a parallel test didn't finish synchronously."), 0);
+			}
+		};
+
+		ParallelFor(
+			Tests.Num(),
+			[this, &Tests, &Parallel, &UpdateBlock](int32 Index) {
+				FParallelTest& Test = Tests[Index];
+				TGuardValue<Spec::FEventSink*> SinkGuard(EventSink, Test.Events.Get());
+				TGuardValue<const Spec::FContext*> ContextGuard(ParallelContext, &Test.Context);
+
+				const double StartTime = FPlatformTime::Seconds();
+				for (const Spec::FBlock* Block : Test.Blocks)
+				{
+					if (!Block->bInternal)
+					{
+						UpdateBlock(*Block);
+					}
+				}
+				Specs[Parallel[Index]].LastDuration = FPlatformTime::Seconds() - StartTime;
+			},
+			EParallelForFlags::Unbalanced);
+
+		// Internal blocks and events run in plan order, as if tests had run one after another
+		for (const FParallelTest& Test : Tests)
 		{
-			It(InDescription, Execution, DefaultTimeout, DoWork);
+			bool bReported = false;
+			for (const Spec::FBlock* Block : Test.Blocks)
+			{
+				if (Block->bInternal)
+				{
+					UpdateBlock(*Block);
+				}
+				else if (!bReported)
+				{
+					Test.Events->Flush(*this);
+					bReported = true;
+				}
+			}
+			++Stats.InlineTests;
 		}
+		return Remaining;
+	}
 
-		void LatentIt(const FString& InDescription, const FTimespan& Timeout,
-			TFunction<void(const FDoneDelegate&)> DoWork)
-		{
-			const TSharedRef<FSpecDefinitionScope> CurrentScope = DefinitionScopeStack.Last();
-			const TArray<FProgramCounterSymbolInfo> Stack = FPlatformStackWalk::GetStack(1, 1);
+	inline bool FTestSpecBase::RunSpec(int32 SpecIndex, bool bAllowInline)
+	{
+		const FSpec& Spec = Specs[SpecIndex];
 
-			PushDescription(InDescription);
-			auto Command = MakeShared<Commands::FUntilDoneLatent>(*this, DoWork, Timeout, bEnableSkipIfError);
-			CurrentScope->It.Push(MakeShared<Spec::FIt>(
-				GetDescription(), GetId(), Stack[0].Filename, Stack[0].LineNumber, Command));
-			PopDescription(InDescription);
-		}
+		TArray<const Spec::FBlock*> SpecBlocks;
+		GatherBlocks(SpecIndex, SpecBlocks);
 
-		void LatentIt(const FString& InDescription, TFunction<void(const FDoneDelegate&)> DoWork)
+		TArray<TSharedRef<IAutomationLatentCommand>> SpecCommands;
+		SpecCommands.Reserve(SpecBlocks.Num());
+		for (const Spec::FBlock* Block : SpecBlocks)
 		{
-			LatentIt(InDescription, DefaultTimeout, DoWork);
+			SpecCommands.Add(Block->Command.ToSharedRef());
 		}
 
-		void LatentIt(const FString& InDescription, EAsyncExecution Execution, const FTimespan& Timeout,
-			TFunction<void(const FDoneDelegate&)> DoWork)
-		{
-			const TSharedRef<FSpecDefinitionScope> CurrentScope = DefinitionScopeStack.Last();
-			const TArray<FProgramCounterSymbolInfo> Stack = FPlatformStackWalk::GetStack(1, 1);
-
-			PushDescription(InDescription);
-			auto Command = MakeShared<Commands::FAsyncUntilDoneLatent>(
-				*this, Execution, DoWork, Timeout, bEnableSkipIfError);
-			CurrentScope->It.Push(MakeShared<Spec::FIt>(
-				GetDescription(), GetId(), Stack[0].Filename, Stack[0].LineNumber, Command));
-			PopDescription(InDescription);
-		}
+		const TSharedRef<IAutomationLatentCommand> Command =
+			MakeShared<Commands::FCompositeLatent>(*this, SpecIndex, MoveTemp(SpecCommands));
 
-		void LatentIt(const FString& InDescription, EAsyncExecution Execution,
-			TFunction<void(const FDoneDelegate&)> DoWork)
+		if (bAllowInline && !Spec.LatentReason)
 		{
-			LatentIt(InDescription, Execution, DefaultTimeout, DoWork);
+			// Only synchronous blocks, so it finishes in a single update
+			verify(Command->Update());
+			++Stats.InlineTests;
+			return true;
 		}
 
-		void BeforeEach(TFunction<void()> DoWork)
-		{
-			DefinitionScopeStack.Last()->BeforeEach.Push(
-				MakeShared<Commands::FSingleExecuteLatent>(*this, DoWork, bEnableSkipIfError));
-		}
+		FAutomationTestFramework::GetInstance().EnqueueLatentCommand(Command);
+		return false;
+	}
 
-		void BeforeEach(EAsyncExecution Execution, const FTimespan& Timeout, TFunction<void()> DoWork)
+	inline FString FTestSpecBase::GetTestSourceFileName(const FString& InTestName) const
+	{
+		const int32 SpecIndex = FindSpecIndexByTestName(InTestName);
+		if (SpecIndex != INDEX_NONE && Specs[SpecIndex].Location.IsValid())
 		{
-			DefinitionScopeStack.Last()->BeforeEach.Push(
-				MakeShared<Commands::FAsyncLatent>(*this, Execution, DoWork, Timeout, bEnableSkipIfError));
+			return FString(Specs[SpecIndex].Location.File);
 		}
 
-		void BeforeEach(EAsyncExecution Execution, TFunction<void()> DoWork)
-		{
-			BeforeEach(Execution, DefaultTimeout, DoWork);
-		}
+		return GetTestSourceFileName();
+	}
 
-		void LatentBeforeEach(const FTimespan& Timeout, TFunction<void(const FDoneDelegate&)> DoWork)
+	inline int32 FTestSpecBase::GetTestSourceFileLine(const FString& InTestName) const
+	{
+		const int32 SpecIndex = FindSpecIndexByTestName(InTestName);
+		if (SpecIndex != INDEX_NONE && Specs[SpecIndex].Location.IsValid())
 		{
-			DefinitionScopeStack.Last()->BeforeEach.Push(
-				MakeShared<Commands::FUntilDoneLatent>(*this, DoWork, Timeout, bEnableSkipIfError));
+			return Specs[SpecIndex].Location.Line;
 		}
 
-		void LatentBeforeEach(TFunction<void(const FDoneDelegate&)> DoWork)
-		{
-			LatentBeforeEach(DefaultTimeout, DoWork);
-		}
+		return GetTestSourceFileLine();
+	}
 
-		void LatentBeforeEach(
-			EAsyncExecution Execution, const FTimespan& Timeout, TFunction<void(const FDoneDelegate&)> DoWork)
-		{
-			DefinitionScopeStack.Last()->BeforeEach.Push(MakeShared<Commands::FAsyncUntilDoneLatent>(
-				*this, Execution, DoWork, Timeout, bEnableSkipIfError));
-		}
+	inline void FTestSpecBase::GetTests(
+		TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+	{
+		EnsureDefinitions();
 
-		void LatentBeforeEach(EAsyncExecution Execution, TFunction<void(const FDoneDelegate&)> DoWork)
-		{
-			LatentBeforeEach(Execution, DefaultTimeout, DoWork);
-		}
+		OutBeautifiedNames.Reserve(OutBeautifiedNames.Num() + Specs.Num());
+		OutTestCommands.Reserve(OutTestCommands.Num() + Specs.Num());
 
-		void AfterEach(TFunction<void()> DoWork)
+		TStringBuilder<256> Name;
+		for (const FSpec& Spec : Specs)
 		{
-			DefinitionScopeStack.Last()->AfterEach.Push(
-				MakeShared<Commands::FSingleExecuteLatent>(*this, DoWork));
-		}
+			Name.Reset();
+			BuildId(Spec, Name);
+			OutTestCommands.Emplace(Name.ToView());
 
-		void AfterEach(EAsyncExecution Execution, const FTimespan& Timeout, TFunction<void()> DoWork)
-		{
-			DefinitionScopeStack.Last()->AfterEach.Push(
-				MakeShared<Commands::FAsyncLatent>(*this, Execution, DoWork, Timeout));
+			Name.Reset();
+			BuildDescription(Spec, Name);
+			if (bShowExecutionPath && Spec.LatentReason)
+			{
+				Name.Appendf(TEXT(" (latent: %s)"), Spec.LatentReason);
+			}
+			OutBeautifiedNames.Emplace(Name.ToView());
 		}
+	}
 
-		void AfterEach(EAsyncExecution Execution, TFunction<void()> DoWork)
-		{
-			AfterEach(Execution, DefaultTimeout, DoWork);
-		}
+	inline void FTestSpecBase::AddIt(
+		const FString& InDescription, const Spec::FSourceLocation& Location, Spec::FBlock Block)
+	{
+		Specs.Emplace(InternName(InDescription), Location, ScopeStack.Last(), MoveTemp(Block));
+	}
 
-		void LatentAfterEach(const FTimespan& Timeout, TFunction<void(const FDoneDelegate&)> DoWork)
-		{
-			DefinitionScopeStack.Last()->AfterEach.Push(
-				MakeShared<Commands::FUntilDoneLatent>(*this, DoWork, Timeout));
-		}
+	inline void FTestSpecBase::AddDefinedBlock(Spec::FBlock Block, bool bAfterEach)
+	{
+		Block.bInternal = bDefiningInternalBlocks;
 
-		void LatentAfterEach(TFunction<void(const FDoneDelegate&)> DoWork)
-		{
-			LatentAfterEach(DefaultTimeout, DoWork);
-		}
+		FDefinedBlock* const Defined =
+			new (DefinitionMemory) FDefinedBlock{MoveTemp(Block), ScopeStack.Last(), bAfterEach};
 
-		void LatentAfterEach(
-			EAsyncExecution Execution, const FTimespan& Timeout, TFunction<void(const FDoneDelegate&)> DoWork)
+		if (LastDefinedBlock)
 		{
-			DefinitionScopeStack.Last()->AfterEach.Push(
-				MakeShared<Commands::FAsyncUntilDoneLatent>(*this, Execution, DoWork, Timeout));
+			LastDefinedBlock->Next = Defined;
 		}
-
-		void LatentAfterEach(EAsyncExecution Execution, TFunction<void(const FDoneDelegate&)> DoWork)
+		else
 		{
-			LatentAfterEach(Execution, DefaultTimeout, DoWork);
+			FirstDefinedBlock = Defined;
 		}
-		// END Enabled Scopes
-
-		// BEGIN Disabled Scopes
-		void xDescribe(const FString& InDescription, TFunction<void()> DoWork) {}
-
-		void xIt(const FString& InDescription, TFunction<void()> DoWork) {}
-		void xIt(const FString& InDescription, EAsyncExecution Execution, TFunction<void()> DoWork) {}
-		void xIt(const FString& InDescription, EAsyncExecution Execution, const FTimespan& Timeout,
-			TFunction<void()> DoWork)
-		{}
+		LastDefinedBlock = Defined;
+	}
 
-		void xLatentIt(const FString& InDescription, TFunction<void(const FDoneDelegate&)> DoWork) {}
-		void xLatentIt(const FString& InDescription, const FTimespan& Timeout,
-			TFunction<void(const FDoneDelegate&)> DoWork)
-		{}
-		void xLatentIt(const FString& InDescription, EAsyncExecution Execution,
-			TFunction<void(const FDoneDelegate&)> DoWork)
-		{}
-		void xLatentIt(const FString& InDescription, EAsyncExecution Execution, const FTimespan& Timeout,
-			TFunction<void(const FDoneDelegate&)> DoWork)
-		{}
+	inline void FTestSpecBase::Describe(const FString& InDescription, TFunctionRef<void()> DoWork)
+	{
+		const int32 ScopeIndex = Scopes.AddDefaulted();
+		Scopes[ScopeIndex].Parent = ScopeStack.Last();
+		Scopes[ScopeIndex].Name = InternName(InDescription);
 
-		void xBeforeEach(TFunction<void()> DoWork) {}
-		void xBeforeEach(EAsyncExecution Execution, TFunction<void()> DoWork) {}
-		void xBeforeEach(EAsyncExecution Execution, const FTimespan& Timeout, TFunction<void()> DoWork) {}
+		ScopeStack.Push(ScopeIndex);
+		DoWork();
+		ScopeStack.Pop();
+	}
 
-		void xLatentBeforeEach(TFunction<void(const FDoneDelegate&)> DoWork) {}
-		void xLatentBeforeEach(const FTimespan& Timeout, TFunction<void(const FDoneDelegate&)> DoWork) {}
-		void xLatentBeforeEach(EAsyncExecution Execution, TFunction<void(const FDoneDelegate&)> DoWork) {}
-		void xLatentBeforeEach(
-			EAsyncExecution Execution, const FTimespan& Timeout, TFunction<void(const FDoneDelegate&)> DoWork)
-		{}
+	inline void FTestSpecBase::PreDefine()
+	{
+		BeforeEach([this]() {
+			CurrentContext = CurrentContext.NextContext();
+		});
+	}
 
-		void xAfterEach(TFunction<void()> DoWork) {}
-		void xAfterEach(EAsyncExecution Execution, TFunction<void()> DoWork) {}
-		void xAfterEach(EAsyncExecution Execution, const FTimespan& Timeout, TFunction<void()> DoWork) {}
+	inline void FTestSpecBase::PostDefine()
+	{
+		AfterEach([this]() {
+			if (IsLastTest())
+			{
+				UE_LOG(LogAutomatron, Verbose,
+					TEXT("%s: %d tests ran inline and %.2fms waiting for worlds"), *TestName,
+					Stats.InlineTests, Stats.WorldPrepTime * 1000.0);
+				UE_LOG(LogAutomatron, Verbose,
+					TEXT("%s: %d latent blocks resumed %.2fms after being done on average (%.2fms at most), "
+						 "%d commands resumed before being polled"),
+					*TestName, Stats.LatentWaits,
+					Stats.LatentWaits > 0 ? Stats.WaitLatency * 1000.0 / Stats.LatentWaits : 0.0,
+					Stats.MaxWaitLatency * 1000.0, Stats.EarlyResumes);
+				CurrentContext = {};
+			}
+		});
+	}
 
-		void xLatentAfterEach(TFunction<void(const FDoneDelegate&)> DoWork) {}
-		void xLatentAfterEach(const FTimespan& Timeout, TFunction<void(const FDoneDelegate&)> DoWork) {}
-		void xLatentAfterEach(EAsyncExecution Execution, TFunction<void(const FDoneDelegate&)> DoWork) {}
-		void xLatentAfterEach(
-			EAsyncExecution Execution, const FTimespan& Timeout, TFunction<void(const FDoneDelegate&)> DoWork)
-		{}
-		// END Disabled Scopes
+	inline void FTestSpecBase::BakeDefinitions()
+	{
+		// Lay out the BeforeEach and then the AfterEach blocks of each scope next to each other
+		TArray<int32> NextBlock;
+		NextBlock.SetNumUninitialized(Scopes.Num() * 2);
 
-		int32 GetNumTests() const
-		{
-			return IdToSpecMap.Num();
-		}
-		int32 GetTestsRemaining() const
-		{
-			return GetNumTests() - CurrentContext.GetId();
-		}
-		Spec::FContext GetCurrentContext() const
+		int32 NumBlocks = 0;
+		for (int32 ScopeIndex = 0; ScopeIndex < Scopes.Num(); ++ScopeIndex)
 		{
-			return CurrentContext;
+			FScope& Scope = Scopes[ScopeIndex];
+			Scope.FirstBlock = NumBlocks;
+			NextBlock[ScopeIndex * 2] = NumBlocks;
+			NextBlock[ScopeIndex * 2 + 1] = NumBlocks + Scope.NumBeforeEach;
+			NumBlocks += Scope.NumBeforeEach + Scope.NumAfterEach;
 		}
-		bool IsFirstTest() const
+
+		Blocks.SetNum(NumBlocks);
+		for (FDefinedBlock* Defined = FirstDefinedBlock; Defined != nullptr;)
 		{
-			return CurrentContext.GetId() == 1;
+			const int32 BlockIndex = NextBlock[Defined->Scope * 2 + (Defined->bAfterEach ? 1 : 0)]++;
+			Blocks[BlockIndex] = MoveTemp(Defined->Block);
+
+			// Its memory is released with the rest of the definition memory
+			FDefinedBlock* const Next = Defined->Next;
+			Defined->~FDefinedBlock();
+			Defined = Next;
 		}
-		bool IsLastTest() const
+		FirstDefinedBlock = nullptr;
+		LastDefinedBlock = nullptr;
+
+		// Parents come before their children, so their reason is always known
+		for (FScope& Scope : Scopes)
 		{
-			return CurrentContext.GetId() == GetNumTests();
+			if (Scope.Parent != INDEX_NONE)
+			{
+				Scope.LatentReason = Scopes[Scope.Parent].LatentReason;
+			}
+
+			const int32 LastBlock = Scope.FirstBlock + Scope.NumBeforeEach + Scope.NumAfterEach;
+			for (int32 Index = Scope.FirstBlock; !Scope.LatentReason && Index < LastBlock; ++Index)
+			{
+				Scope.LatentReason = Blocks[Index].LatentReason;
+			}
 		}
 
-	protected:
-		void EnsureDefinitions() const;
+		const TCHAR* const SpecLatentReason = GetLatentReason();
 
-		virtual void RunDefine()
+		IdHashToSpecMap.Reserve(Specs.Num());
+		TStringBuilder<256> Id;
+		for (int32 SpecIndex = 0; SpecIndex < Specs.Num(); ++SpecIndex)
 		{
-			PreDefine();
-			Define();
-			PostDefine();
+			FSpec& Spec = Specs[SpecIndex];
+			Spec.LatentReason = SpecLatentReason;
+			if (!Spec.LatentReason)
+			{
+				Spec.LatentReason = Scopes[Spec.Scope].LatentReason;
+			}
+			if (!Spec.LatentReason)
+			{
+				Spec.LatentReason = Spec.Block.LatentReason;
+			}
+
+			Id.Reset();
+			BuildId(Spec, Id);
+			checkf(FindSpecIndex(Id.ToView()) == INDEX_NONE, TEXT("Test id '%s' is not unique"),
+				Id.ToString());
+			IdHashToSpecMap.Add(HashId(Id.ToView()), SpecIndex);
 		}
-		virtual void PreDefine();
-		virtual void Define() = 0;
-		virtual void PostDefine();
 
-		void BakeDefinitions();
+		BuildExecutionPlan();
 
-		void Redefine();
+		NameHashToNameMap.Empty();
+		ScopeStack.Empty();
+		bHasBeenDefined = true;
+	}
 
-	private:
-		void PushDescription(const FString& InDescription)
-		{
-			Description.Add(InDescription);
-		}
+	inline void FTestSpecBase::Redefine()
+	{
+		Names.Empty();
+		NameHashToNameMap.Empty();
+		Specs.Empty();
+		IdHashToSpecMap.Empty();
+		ExecutionPlan.Empty();
+		Scopes.Empty();
+		Blocks.Empty();
+		ScopeStack.Empty();
+
+		Scopes.AddDefaulted();
+		ScopeStack.Push(0);
+		bHasBeenDefined = false;
+	}
 
-		void PopDescription(const FString& InDescription)
+	inline void FTestSpecBase::BuildExecutionPlan()
+	{
+		ExecutionPlan.Reset(Specs.Num());
+		for (int32 SpecIndex = 0; SpecIndex < Specs.Num(); ++SpecIndex)
 		{
-			Description.RemoveAt(Description.Num() - 1);
+			ExecutionPlan.Add(SpecIndex);
 		}
 
-		FString GetDescription() const;
-
-		FString GetId() const;
-	};
+		SortExecutionPlan(ExecutionPlan);
+		check(ExecutionPlan.Num() == Specs.Num());
+	}
 
-	class FTestSpec : public FTestSpecBase
+	inline void FTestSpecBase::SortExecutionPlan(TArray<int32>& Plan) const
 	{
-	public:
-		// Should a world be initialized?
-		bool bUseWorld = true;
+		switch (ExecutionOrder)
+		{
+			case Spec::EExecutionOrder::Affinity:
+			{
+				// Group of each spec, by the first appearance of its latent reason. Inline specs are group 0
+				TArray<const TCHAR*, TInlineAllocator<8>> Reasons;
+				TArray<int32> Groups;
+				Groups.SetNumUninitialized(Specs.Num());
+				for (int32 SpecIndex = 0; SpecIndex < Specs.Num(); ++SpecIndex)
+				{
+					const TCHAR* Reason = Specs[SpecIndex].LatentReason;
+					int32 Group = 0;
+					if (Reason)
+					{
+						Group = Reasons.IndexOfByPredicate([Reason](const TCHAR* Other) {
+							return FCString::Strcmp(Reason, Other) == 0;
+						});
+						if (Group == INDEX_NONE)
+						{
+							Group = Reasons.Add(Reason);
+						}
+						++Group;
+					}
+					Groups[SpecIndex] = Group;
+				}
 
-		// If true the world used for testing will be reused for all tests
-		bool bReuseWorldForAllTests = true;
+				Plan.StableSort([&Groups](int32 A, int32 B) {
+					return Groups[A] < Groups[B];
+				});
+				break;
+			}
+			case Spec::EExecutionOrder::SlowestFirst:
+			{
+				Plan.StableSort([this](int32 A, int32 B) {
+					return Specs[A].LastDuration > Specs[B].LastDuration;
+				});
+				break;
+			}
+			default:
+				break;
+		}
+	}
 
-		// If true and in editor, a PIE instance will be used to test
-		bool bCanUsePIEWorld = true;
+	inline FString FTestSpecBase::GetTestId(int32 SpecIndex) const
+	{
+		TStringBuilder<256> Id;
+		BuildId(Specs[SpecIndex], Id);
+		return FString(Id.ToView());
+	}
 
-		FTestWorldSettings DefaultWorldSettings;
+	inline int32 FTestSpecBase::InternName(const FString& Name)
+	{
+		// Names are case sensitive, unlike ids
+		const uint32 Hash = FCrc::StrCrc32(*Name);
+		for (auto It = NameHashToNameMap.CreateConstKeyIterator(Hash); It; ++It)
+		{
+			if (Names[It.Value()].Equals(Name, ESearchCase::CaseSensitive))
+			{
+				return It.Value();
+			}
+		}
 
-	private:
-		FString ClassName;
-		FString PrettyName;
-		FString FileName;
-		int32 LineNumber = -1;
-		uint32 Flags = 0;
+		const int32 NameIndex = Names.Add(Name);
+		NameHashToNameMap.Add(Hash, NameIndex);
+		return NameIndex;
+	}
 
-		bool bInitializedWorld = false;
-#if WITH_EDITOR
-		bool bInitializedPIE = false;
-		FDelegateHandle PIEStartedHandle;
-#endif
+	inline void FTestSpecBase::GetScopeChain(int32 ScopeIndex, FScopeChain& OutChain) const
+	{
+		for (; ScopeIndex != INDEX_NONE; ScopeIndex = Scopes[ScopeIndex].Parent)
+		{
+			OutChain.Add(ScopeIndex);
+		}
+	}
 
-		TWeakObjectPtr<UWorld> MainWorld;
+	inline void FTestSpecBase::BuildDescription(const FSpec& Spec, FStringBuilderBase& OutDescription) const
+	{
+		const int32 Start = OutDescription.Len();
+		auto AppendName = [this, &OutDescription, Start](int32 NameIndex) {
+			if (NameIndex == INDEX_NONE || Names[NameIndex].IsEmpty())
+			{
+				return;
+			}
 
-	public:
-		FTestSpec() : FTestSpecBase() {}
+			if (OutDescription.Len() > Start)
+			{
+				OutDescription.AppendChar(TEXT('.'));
+			}
+			OutDescription.Append(Names[NameIndex]);
+		};
 
-		virtual FString GetTestSourceFileName() const override
+		FScopeChain ScopeChain;
+		GetScopeChain(Spec.Scope, ScopeChain);
+		for (int32 ChainIndex = ScopeChain.Num() - 1; ChainIndex >= 0; --ChainIndex)
 		{
-			return FileName;
+			AppendName(Scopes[ScopeChain[ChainIndex]].Name);
 		}
-		virtual int32 GetTestSourceFileLine() const override
+		AppendName(Spec.Name);
+	}
+
+	inline void FTestSpecBase::BuildId(const FSpec& Spec, FStringBuilderBase& OutId) const
+	{
+		const FString& ItName = Names[Spec.Name];
+		if (ItName.EndsWith(TEXT("]")))
 		{
-			return LineNumber;
+			int32 StartingBraceIndex = INDEX_NONE;
+			if (ItName.FindLastChar(TEXT('['), StartingBraceIndex) && StartingBraceIndex != ItName.Len() - 2)
+			{
+				OutId.Append(
+					FStringView(*ItName + StartingBraceIndex + 1, ItName.Len() - StartingBraceIndex - 2));
+				return;
+			}
 		}
-		virtual uint32 GetTestFlags() const override
+
+		const int32 Start = OutId.Len();
+		auto AppendName = [this, &OutId, Start](int32 NameIndex) {
+			if (NameIndex == INDEX_NONE || Names[NameIndex].IsEmpty())
+			{
+				return;
+			}
+
+			const FString& Name = Names[NameIndex];
+			if (OutId.Len() > Start && !FChar::IsWhitespace(OutId.LastChar()) &&
+				!FChar::IsWhitespace(Name[0]))
+			{
+				OutId.AppendChar(TEXT(' '));
+			}
+			OutId.Append(Name);
+		};
+
+		FScopeChain ScopeChain;
+		GetScopeChain(Spec.Scope, ScopeChain);
+		for (int32 ChainIndex = ScopeChain.Num() - 1; ChainIndex >= 0; --ChainIndex)
 		{
-			return Flags;
+			AppendName(Scopes[ScopeChain[ChainIndex]].Name);
 		}
+		AppendName(Spec.Name);
+	}
 
-		const FString& GetClassName() const
+	inline int32 FTestSpecBase::FindSpecIndex(FStringView Id) const
+	{
+		TStringBuilder<256> SpecId;
+		for (auto It = IdHashToSpecMap.CreateConstKeyIterator(HashId(Id)); It; ++It)
 		{
-			return ClassName;
+			SpecId.Reset();
+			BuildId(Specs[It.Value()], SpecId);
+			if (SpecId.ToView().Equals(Id, ESearchCase::IgnoreCase))
+			{
+				return It.Value();
+			}
 		}
-		const FString& GetPrettyName() const
+		return INDEX_NONE;
+	}
+
+	inline int32 FTestSpecBase::FindSpecIndexByTestName(const FString& InTestName) const
+	{
+		return FindSpecIndex(Spec::GetTestIdFromName(InTestName, TestName));
+	}
+
+	inline uint32 FTestSpecBase::HashId(FStringView Id)
+	{
+		// FNV-1a over lowercase characters
+		uint32 Hash = 2166136261u;
+		for (const TCHAR Char : Id)
 		{
-			return PrettyName;
+			Hash = (Hash ^ static_cast<uint32>(FChar::ToLower(Char))) * 16777619u;
 		}
+		return Hash;
+	}
 
-	protected:
-		virtual FString GetBeautifiedTestName() const override
+	inline void FTestSpec::PreDefine()
+	{
+		FTestSpecBase::PreDefine();
+
+		if (bUseWorld)
 		{
-			return PrettyName;
+			AddWorldPreparation();
 		}
+	}
 
-		template <uint32 TFlags>
-		void Setup(FString&& InName, FString&& InPrettyName, FString&& InFileName, int32 InLineNumber);
-
-		// Used to indicate a test is pending to be implemented.
-		void TestNotImplemented()
+	inline void FTestSpec::UseWorld()
+	{
+		// Otherwise all tests already prepare the world
+		if (!bUseWorld)
 		{
-			AddWarning(TEXT("Test not implemented"), 1);
+			AddWorldPreparation();
 		}
+	}
 
-		virtual void PreDefine() override;
-		virtual void PostDefine() override;
+	inline void FTestSpec::AddWorldPreparation()
+	{
+		LatentBeforeEach(EAsyncExecution::TaskGraphMainThread, [this](const auto Done) {
+			PrepareTestWorld([this, Done](UWorld* InWorld) {
+				MainWorld = InWorld;
+				if (bRestoreWorldBetweenTests && bReuseWorldForAllTests && InWorld &&
+					WorldSnapshot.GetWorld() != InWorld)
+				{
+					WorldSnapshot.Capture(InWorld);
+				}
+				Done.Execute();
+			});
+		});
+	}
 
-		void PrepareTestWorld(TFunction<void(UWorld* World)> OnWorldReady);
+	inline void FTestSpec::PostDefine()
+	{
+		AfterEach([this]() {
+			// Restoring is faster than creating the world again. If it fails, the world is released instead
+			const bool bRestored = bReuseWorldForAllTests && !IsLastTest() &&
+								   WorldSnapshot.GetWorld() == MainWorld.Get() && WorldSnapshot.Restore();
 
-		void ReleaseTestWorld(UWorld* World);
+			// If this spec initialized a PIE world, tear it down
+			if (!bReuseWorldForAllTests || IsLastTest() || (WorldSnapshot.IsCaptured() && !bRestored))
+			{
+				WorldSnapshot.Reset();
+				ReleaseTestWorld(MainWorld.Get());
+
+				// Released worlds may be handed out again, so they are not ticked by this spec anymore
+				MainWorld.Reset();
+			}
+		});
 
-		// Creates an empty world from scratch
-		// @return world that was created
-		UWorld* CreateWorld(FTestWorldSettings Settings = {});
+		FTestSpecBase::PostDefine();
+	}
 
-		void TickWorldUntil(UWorld* World, bool bUseRealtime, TFunction<bool(float)> Delegate);
-		void TickWorld(UWorld* World, float Duration, bool bUseRealtime = false);
+	inline void FTestSpec::PrepareTestWorld(TFunction<void(UWorld* World)> OnWorldReady)
+	{
+		checkf(IsInGameThread(), TEXT("PrepareTestWorld can only be run on game thread."));
 
-		UGameInstance* CreateGameInstance(const FTestWorldSettings& Settings, UObject* Context);
+		const double StartTime = FPlatformTime::Seconds();
 
-		bool DestroyWorld(UWorld* World);
+		UWorld* SelectedWorld = FindGameWorld();
 
-		UWorld* GetMainWorld() const
+#if WITH_EDITOR
+		// If there was no PIE world, start it and try again
+		if (bCanUsePIEWorld && !SelectedWorld && GIsEditor)
 		{
-			return MainWorld.Get();
+			PIEStartedHandle =
+				FEditorDelegates::PostPIEStarted.AddLambda([this, OnWorldReady](const bool bIsSimulating) {
+					UWorld* SelectedWorld = FindGameWorld();
+					bInitializedPIE = SelectedWorld != nullptr;
+					bInitializedWorld = bInitializedPIE;
+					if (bKeepPIEWorld && SelectedWorld)
+					{
+						Spec::FPersistentPIE::Get().Keep(SelectedWorld);
+					}
+
+					OnWorldReady(SelectedWorld);
+				});
+			FEditorPromotionTestUtilities::StartPIE(false);
+			return;
 		}
+#endif
 
-	private:
-		void Reregister(const FString& NewName)
+		if (!SelectedWorld)
 		{
-			FAutomationTestFramework::Get().UnregisterAutomationTest(TestName);
-			TestName = NewName;
-			FAutomationTestFramework::Get().RegisterAutomationTest(TestName, this);
+			SelectedWorld = bUseWorldPool ? Spec::FWorldPool::Get().Acquire(*this, DefaultWorldSettings)
+										  : CreateWorld(DefaultWorldSettings);
+			bInitializedWorld = true;
+			bPooledWorld = bUseWorldPool;
 		}
 
-		// Finds the first available game world (Standalone or PIE)
-		static UWorld* FindGameWorld();
-
-		static bool SetGameMode(UWorld* World, FTestWorldSettings& Settings);
-	};
+		const double PrepTime = FPlatformTime::Seconds() - StartTime;
+		GetMutableStats().WorldPrepTime += PrepTime;
+		UE_LOG(LogAutomatron, Verbose, TEXT("%s: World ready in %.2fms"), *TestName, PrepTime * 1000.0);
 
-	namespace Spec
-	{
-		template <typename T>
-		TRegister<T> TRegister<T>::Instance{};
+		OnWorldReady(SelectedWorld);
 	}
 
-	static void RegisterSpecs()
+	inline void FTestSpec::ReleaseTestWorld(UWorld* World)
 	{
-		Spec::FRegister::OnSetup().Broadcast();
-	}
-}	 // namespace Automatron
-
-
-////////////////////////////////////////////////////////////////
-// GENERATION MACROS
-
-#define GENERATE_SPEC(TClass, PrettyName, TFlags) \
-	GENERATE_SPEC_PRIVATE(TClass, PrettyName, TFlags, __FILE__, __LINE__)
-
-#define GENERATE_SPEC_PRIVATE(TClass, PrettyName, TFlags, FileName, LineNumber)          \
-private:                                                                                 \
-	void Setup()                                                                         \
-	{                                                                                    \
-		FTestSpec::Setup<TFlags>(TEXT(#TClass), TEXT(PrettyName), FileName, LineNumber); \
-	}                                                                                    \
-	static Automatron::Spec::TRegister<TClass>& __meta_register()                        \
-	{                                                                                    \
-		return Automatron::Spec::TRegister<TClass>::Instance;                            \
-	}                                                                                    \
-	friend Automatron::Spec::TRegister<TClass>;                                          \
-                                                                                         \
-	virtual void Define() override
-
-#define SPEC(TClass, TParent, PrettyName, TFlags)  \
-	class TClass : public TParent                  \
-	{                                              \
-		GENERATE_SPEC(TClass, PrettyName, TFlags); \
-	};                                             \
-	void TClass::Define()
+		if (!IsInGameThread())
+		{
+			AsyncTask(ENamedThreads::GameThread, [this, World]() {
+				ReleaseTestWorld(World);
+			});
+			return;
+		}
 
+#if WITH_EDITOR
+		FEditorDelegates::PostPIEStarted.Remove(PIEStartedHandle);
 
-////////////////////////////////////////////////////////////////
-// DECLARATIONS
+		// A kept PIE session is restored for the next spec, whoever started it
+		Spec::FPersistentPIE& PersistentPIE = Spec::FPersistentPIE::Get();
+		const bool bPersistentPIE = PersistentPIE.Owns(World);
+		if (bPersistentPIE && PersistentPIE.Restore())
+		{
+			bInitializedPIE = false;
+			bInitializedWorld = false;
+			return;
+		}
 
-namespace Automatron
-{
-	namespace Commands
-	{
-		inline bool FSingleExecuteLatent::Update()
+		if (bInitializedPIE || bPersistentPIE)
 		{
-			if (bSkipIfErrored && Spec.HasAnyErrors())
+			if (bPersistentPIE)
 			{
-				return true;
+				PersistentPIE.End();
+			}
+			else
+			{
+				FEditorPromotionTestUtilities::EndPIE();
 			}
+			bInitializedPIE = false;
+			bInitializedWorld = false;
+			return;
+		}
+#endif
 
-			Predicate();
-			return true;
+		if (!bInitializedWorld)
+		{
+			return;
 		}
 
-		inline bool FUntilDoneLatent::Update()
+		// If world is not PIE, we take care of its teardown
+		if (!bPooledWorld || !Spec::FWorldPool::Get().Release(World))
 		{
-			if (!bIsRunning)
-			{
-				if (bSkipIfErrored && Spec.HasAnyErrors())
-				{
-					return true;
-				}
+			DestroyWorld(World);
+		}
+		bInitializedWorld = false;
+		bPooledWorld = false;
+	}
 
-				Predicate(FDoneDelegate::CreateSP(this, &FUntilDoneLatent::Done));
-				bIsRunning = true;
-				StartedRunning = FDateTime::UtcNow();
+	inline UWorld* FTestSpec::InitializeWorld(FTestWorldSettings Settings)
+	{
+		UWorld* World = Settings.Map.IsNull() ? nullptr : CreateMapWorld(Settings);
+		if (Settings.Profile == ETestWorldProfile::LogicOnly)
+		{
+			// A game instance would create a full world of its own, so logic-only worlds have none
+			if (!World)
+			{
+				World = CreateLogicOnlyWorld();
 			}
-
-			if (bDone)
+			GEngine->CreateNewWorldContext(EWorldType::Game).SetCurrentWorld(World);
+		}
+		else
+		{
+			auto* GameInstance = CreateGameInstance(Settings, GEngine);
+			GameInstance->AddToRoot();
+			GameInstance->InitializeStandalone(TEXT("FAbilitySpec::World"), nullptr);
+			if (World)
 			{
-				Reset();
-				return true;
+				SetWorldGameInstance(World, GameInstance);
 			}
-			else if (FDateTime::UtcNow() >= StartedRunning + Timeout)
+			else
 			{
-				Reset();
-				Spec.AddError(TEXT("Latent command timed out."), 0);
-				return true;
+				World = GameInstance->GetWorld();
 			}
+		}
 
-			return false;
+		const bool bInformEngineOfWorld = true;
+		if (GEngine && bInformEngineOfWorld)
+		{
+			GEngine->WorldAdded(World);
 		}
 
-		inline void FUntilDoneLatent::Reset()
+		World->SetShouldTick(Settings.bShouldTick);
+		SetGameMode(World, Settings);
+
+		World->AddToRoot();
+		return World;
+	}
+
+	inline void FTestSpec::BeginWorldPlay(UWorld* World)
+	{
+		FURL URL;
+		World->InitializeActorsForPlay(URL);
+		World->BeginPlay();
+	}
+
+	inline UWorld* FTestSpec::CreateLogicOnlyWorld()
+	{
+		const UWorld::InitializationValues Values = GetInitializationValues(ETestWorldProfile::LogicOnly);
+		return UWorld::CreateWorld(EWorldType::Game, false, TEXT("AutomatronLogicOnlyWorld"), nullptr, true,
+			ERHIFeatureLevel::Num, &Values);
+	}
+
+	inline UWorld* FTestSpec::CreateMapWorld(const FTestWorldSettings& Settings)
+	{
+		UWorld* const Map = Spec::FMapCache::Get().Load(Settings.Map);
+		if (!Map)
 		{
-			// Reset the done for the next potential run of this command
-			bDone = false;
-			bIsRunning = false;
+			UE_LOG(LogAutomatron, Error, TEXT("Couldn't load map '%s'"),
+				*Settings.Map.ToSoftObjectPath().ToString());
+			return nullptr;
 		}
 
-		inline bool FAsyncUntilDoneLatent::Update()
+		// Each copy lives in its own package, as PIE copies do. Named after the packages that exist, so
+		// that specs of any module get a new one
+		const FString BaseName = FString::Printf(TEXT("%s%s"), MapCopiesPath, *Map->GetName());
+		const FName PackageName = MakeUniqueObjectName(nullptr, UPackage::StaticClass(), FName(*BaseName));
+		UPackage* const Package = CreatePackage(*PackageName.ToString());
+		Package->SetFlags(RF_Transient);
+
+		FObjectDuplicationParameters Parameters(Map, Package);
+		Parameters.DestName = Map->GetFName();
+		// Unlike the map, the copy is collected once destroyed
+		Parameters.FlagMask = RF_AllFlags & ~(RF_Standalone | RF_Public);
+		Parameters.PortFlags = PPF_DuplicateForPIE;
+		Parameters.DuplicateMode = EDuplicateMode::World;
+
+		UWorld* World = CastChecked<UWorld>(StaticDuplicateObjectEx(Parameters));
+		if (World->GetStreamingLevels().Num() > 0)
 		{
-			if (!Future.IsValid())
-			{
-				if (bSkipIfErrored && Spec.HasAnyErrors())
-				{
-					return true;
-				}
+			UE_LOG(LogAutomatron, Warning, TEXT("Streaming levels of map '%s' are not loaded in test worlds"),
+				*Map->GetName());
+			World->ClearStreamingLevels();
+		}
+		World->WorldType = EWorldType::Game;
+		World->InitWorld(GetInitializationValues(Settings.Profile));
+		return World;
+	}
 
-				Future = Async(Execution, [this]() {
-					Predicate(FDoneDelegate::CreateRaw(this, &FAsyncUntilDoneLatent::Done));
-				});
+	inline UWorld::InitializationValues FTestSpec::GetInitializationValues(ETestWorldProfile Profile)
+	{
+		UWorld::InitializationValues Values;
+		if (Profile == ETestWorldProfile::LogicOnly)
+		{
+			Values.InitializeScenes(false)
+				.AllowAudioPlayback(false)
+				.RequiresHitProxies(false)
+				.CreatePhysicsScene(false)
+				.CreateNavigation(false)
+				.CreateAISystem(false)
+				.ShouldSimulatePhysics(false)
+				.EnableTraceCollision(false)
+				.SetTransactional(false)
+				.CreateFXSystem(false);
+		}
+		return Values;
+	}
 
-				StartedRunning = FDateTime::UtcNow();
-			}
+	inline void FTestSpec::SetWorldGameInstance(UWorld* World, UGameInstance* GameInstance)
+	{
+		// InitializeStandalone is the only way to give a game instance its world context, but it
+		// creates an empty world for it. The context is moved to our world and the empty one destroyed
+		UWorld* const EmptyWorld = GameInstance->GetWorld();
+		GameInstance->GetWorldContext()->SetCurrentWorld(World);
+		World->SetGameInstance(GameInstance);
 
-			if (bDone)
-			{
-				Reset();
-				return true;
-			}
-			else if (FDateTime::UtcNow() >= StartedRunning + Timeout)
-			{
-				Reset();
-				Spec.AddError(TEXT("Latent command timed out."), 0);
-				return true;
-			}
-			return false;
+		if (EmptyWorld)
+		{
+			EmptyWorld->DestroyWorld(false);
+			EmptyWorld->RemoveFromRoot();
 		}
+	}
+
+	inline void FTestSpec::TickWorldUntil(UWorld* World, const FTestTickSettings& Settings, bool bUseRealtime,
+		TFunction<bool(float)> Delegate)
+	{
+		check(IsInGameThread());
+
+		// Game time between calls to the delegate
+		const int32 SubSteps = FMath::Max(Settings.SubSteps, 1);
+		const float Step = Settings.Step * SubSteps;
 
-		inline void FAsyncUntilDoneLatent::Reset()
+		TArray<TWeakObjectPtr<AActor>> DisabledActors;
+		TArray<TWeakObjectPtr<UActorComponent>> DisabledComponents;
+		if (Settings.HasFilters())
 		{
-			// Reset the done for the next potential run of this command
-			bDone = false;
-			Future = TFuture<void>();
+			DisableFilteredTicks(World, Settings, DisabledActors, DisabledComponents);
 		}
 
-		inline bool FAsyncLatent::Update()
+		float DeltaTime = Step;
+		while (IsValid(World) && Delegate(DeltaTime))
 		{
-			if (!Future.IsValid())
+			int32 TickCycles = 0;
+			CLOCK_CYCLES(TickCycles);
+			for (int32 SubStep = 0; SubStep < SubSteps; ++SubStep)
 			{
-				if (bSkipIfErrored && Spec.HasAnyErrors())
-				{
-					return true;
-				}
+				World->Tick(Settings.TickType, DeltaTime / SubSteps);
 
-				Future = Async(Execution, [this]() {
-					Predicate();
-					bDone = true;
-				});
-
-				StartedRunning = FDateTime::UtcNow();
+				// This is terrible but required for subticking like this.
+				// we could always cache the real GFrameCounter at the start of our tests
+				// and restore it when finished.
+				++GFrameCounter;
 			}
+			UNCLOCK_CYCLES(TickCycles);
 
-			if (bDone)
-			{
-				Reset();
-				return true;
-			}
-			else if (FDateTime::UtcNow() >= StartedRunning + Timeout)
+			if (bUseRealtime)
 			{
-				Reset();
-				Spec.AddError(TEXT("Latent command timed out."), 0);
-				return true;
-			}
+				const float TickDuration = FPlatformTime::ToSeconds(TickCycles);
+				if (TickDuration < Step)
+				{
+					FPlatformProcess::Sleep(Step - TickDuration);
+				}
 
-			return false;
+				DeltaTime = FMath::Max(TickDuration, Step);
+			}
 		}
 
-		inline void FAsyncLatent::Reset()
+		for (const TWeakObjectPtr<AActor>& Actor : DisabledActors)
 		{
-			// Reset the done for the next potential run of this command
-			bDone = false;
-			Future = TFuture<void>();
+			if (Actor.IsValid())
+			{
+				Actor->SetActorTickEnabled(true);
+			}
 		}
-	}	 // namespace Commands
-
-	inline void FTestSpecBase::EnsureDefinitions() const
-	{
-		if (!bHasBeenDefined)
+		for (const TWeakObjectPtr<UActorComponent>& Component : DisabledComponents)
 		{
-			const_cast<FTestSpecBase*>(this)->RunDefine();
-			const_cast<FTestSpecBase*>(this)->BakeDefinitions();
+			if (Component.IsValid())
+			{
+				Component->SetComponentTickEnabled(true);
+			}
 		}
 	}
 
-	inline FString FTestSpecBase::GetTestSourceFileName() const
+	inline void FTestSpec::TickWorld(
+		UWorld* World, float Duration, const FTestTickSettings& Settings, bool bUseRealtime)
 	{
-		return FAutomationTestBase::GetTestSourceFileName();
+		TickWorldUntil(World, Settings, bUseRealtime, [&Duration](float DeltaTime) {
+			Duration -= DeltaTime;
+			return Duration > 0.f;
+		});
 	}
 
-	inline int32 FTestSpecBase::GetTestSourceFileLine() const
+	inline void FTestSpec::WarpTime(double Deadline, TFunctionRef<bool()> IsWaiting)
 	{
-		return FAutomationTestBase::GetTestSourceFileLine();
+		UWorld* const World = GetMainWorld();
+		if (!bInitializedWorld || !IsValid(World) || World->IsPlayInEditor())
+		{
+			FTestSpecBase::WarpTime(Deadline, IsWaiting);
+			return;
+		}
+
+		// Each call to the delegate is a step of virtual time, ticked in substeps
+		FTestTickSettings Settings = DefaultTickSettings;
+		Settings.Step = VirtualTimeStep / FMath::Max(Settings.SubSteps, 1);
+
+		int32 Step = 0;
+		TickWorldUntil(World, Settings, false, [this, Deadline, IsWaiting, &Step](float DeltaTime) {
+			if (Step >= MaxVirtualStepsPerFrame || GetTime() >= Deadline || !IsWaiting())
+			{
+				return false;
+			}
+			++Step;
+			AdvanceVirtualTime(DeltaTime);
+			return true;
+		});
 	}
 
-	inline bool FTestSpecBase::RunTest(const FString& InParameters)
+	inline void FTestSpec::DisableFilteredTicks(UWorld* World, const FTestTickSettings& Settings,
+		TArray<TWeakObjectPtr<AActor>>& OutActors, TArray<TWeakObjectPtr<UActorComponent>>& OutComponents)
 	{
-		EnsureDefinitions();
-
-		if (!InParameters.IsEmpty())
+		TArray<UActorComponent*> Components;
+		for (FActorIterator ActorIt(World); ActorIt; ++ActorIt)
 		{
-			const TSharedRef<FSpec>* SpecToRun = IdToSpecMap.Find(InParameters);
-			if (SpecToRun != nullptr)
+			AActor* const Actor = *ActorIt;
+			const bool bActorTicks = Settings.ShouldTick(Actor);
+			if (!bActorTicks && Actor->IsActorTickEnabled())
 			{
-				for (int32 Index = 0; Index < (*SpecToRun)->Commands.Num(); ++Index)
-				{
-					FAutomationTestFramework::GetInstance().EnqueueLatentCommand(
-						(*SpecToRun)->Commands[Index]);
-				}
+				Actor->SetActorTickEnabled(false);
+				OutActors.Add(Actor);
 			}
-		}
-		else
-		{
-			TArray<TSharedRef<FSpec>> Specs;
-			IdToSpecMap.GenerateValueArray(Specs);
 
-			for (int32 SpecIndex = 0; SpecIndex < Specs.Num(); SpecIndex++)
+			Components.Reset();
+			Actor->GetComponents(Components);
+			for (UActorComponent* Component : Components)
 			{
-				for (int32 CommandIndex = 0; CommandIndex < Specs[SpecIndex]->Commands.Num(); ++CommandIndex)
+				if ((!bActorTicks || !Settings.ShouldTick(Component)) && Component->IsComponentTickEnabled())
 				{
-					FAutomationTestFramework::GetInstance().EnqueueLatentCommand(
-						Specs[SpecIndex]->Commands[CommandIndex]);
+					Component->SetComponentTickEnabled(false);
+					OutComponents.Add(Component);
 				}
 			}
 		}
-
-		TestsRemaining = GetNumTests();
-		return true;
 	}
 
-	inline FString FTestSpecBase::GetTestSourceFileName(const FString& InTestName) const
+	inline UGameInstance* FTestSpec::CreateGameInstance(const FTestWorldSettings& Settings, UObject* Context)
 	{
-		FString TestId = InTestName;
-		if (TestId.StartsWith(TestName + TEXT(" ")))
+		UClass* GameInstanceClass = Settings.GameInstance.Get();
+		if (!GameInstanceClass)
 		{
-			TestId = InTestName.RightChop(TestName.Len() + 1);
+			FSoftClassPath GameInstanceClassName = GetDefault<UGameMapsSettings>()->GameInstanceClass;
+			GameInstanceClass = GameInstanceClassName.TryLoadClass<UGameInstance>();
 		}
 
-		const TSharedRef<FSpec>* Spec = IdToSpecMap.Find(TestId);
-		if (Spec != nullptr)
+		if (!GameInstanceClass)
 		{
-			return (*Spec)->Filename;
+			GameInstanceClass = UGameInstance::StaticClass();
 		}
-
-		return GetTestSourceFileName();
+		return NewObject<UGameInstance>(Context, GameInstanceClass);
 	}
 
-	inline int32 FTestSpecBase::GetTestSourceFileLine(const FString& InTestName) const
+	inline bool FTestSpec::DestroyWorld(UWorld* World)
 	{
-		FString TestId = InTestName;
-		if (TestId.StartsWith(TestName + TEXT(" ")))
+		// If world is not PIE, we take care of its teardown
+		if (World && !World->IsPlayInEditor())
 		{
-			TestId = InTestName.RightChop(TestName.Len() + 1);
-		}
+			World->BeginTearingDown();
 
-		const TSharedRef<FSpec>* Spec = IdToSpecMap.Find(TestId);
-		if (Spec != nullptr)
-		{
-			return (*Spec)->LineNumber;
-		}
+			// Cancel any pending connection to a server
+			GEngine->CancelPending(World);
 
-		return GetTestSourceFileLine();
-	}
+			// Shut down any existing game connections
+			GEngine->ShutdownWorldNetDriver(World);
 
-	inline void FTestSpecBase::GetTests(
-		TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
-	{
-		EnsureDefinitions();
+			for (FActorIterator ActorIt(World); ActorIt; ++ActorIt)
+			{
+				ActorIt->RouteEndPlay(EEndPlayReason::Quit);
+			}
 
-		TArray<TSharedRef<FSpec>> Specs;
-		IdToSpecMap.GenerateValueArray(Specs);
+			if (auto* GameInstance = World->GetGameInstance())
+			{
+				GameInstance->Shutdown();
+				GameInstance->RemoveFromRoot();
+			}
 
-		for (int32 Index = 0; Index < Specs.Num(); Index++)
-		{
-			OutTestCommands.Push(Specs[Index]->Id);
-			OutBeautifiedNames.Push(Specs[Index]->Description);
+			GEngine->DestroyWorldContext(World);
+			World->DestroyWorld(false);
+
+			// Copies of maps are the only objects of their package
+			UPackage* const Package = World->GetOutermost();
+			if (Package->GetName().StartsWith(MapCopiesPath))
+			{
+				Package->ClearFlags(RF_Standalone | RF_Public);
+				Package->MarkAsGarbage();
+			}
+			return true;
 		}
+		return false;
 	}
 
-	inline void FTestSpecBase::Describe(const FString& InDescription, TFunction<void()> DoWork)
+	inline UWorld* FTestSpec::FindGameWorld()
 	{
-		const TSharedRef<FSpecDefinitionScope> ParentScope = DefinitionScopeStack.Last();
-		const TSharedRef<FSpecDefinitionScope> NewScope = MakeShared<FSpecDefinitionScope>();
-		NewScope->Description = InDescription;
-		ParentScope->Children.Push(NewScope);
-
-		DefinitionScopeStack.Push(NewScope);
-		PushDescription(InDescription);
-		DoWork();
-		PopDescription(InDescription);
-		DefinitionScopeStack.Pop();
-
-		if (NewScope->It.Num() == 0 && NewScope->Children.Num() == 0)
+		const TIndirectArray<FWorldContext>& WorldContexts = GEngine->GetWorldContexts();
+		for (const FWorldContext& Context : WorldContexts)
 		{
-			ParentScope->Children.Remove(NewScope);
+			if (Context.World() != nullptr)
+			{
+				if (Context.WorldType == EWorldType::PIE /*&& Context.PIEInstance == 0*/)
+				{
+					return Context.World();
+				}
+
+				// Pooled worlds are game worlds too, but only handed out by the pool
+				if (Context.WorldType == EWorldType::Game && !Spec::FWorldPool::Get().Owns(Context.World()))
+				{
+					return Context.World();
+				}
+			}
 		}
+		return nullptr;
 	}
 
-	inline void FTestSpecBase::PreDefine()
+	inline bool FTestSpec::SetGameMode(UWorld* World, FTestWorldSettings& Settings)
 	{
-		BeforeEach([this]() {
-			CurrentContext = CurrentContext.NextContext();
-		});
+		if ((!World->IsNetMode(NM_DedicatedServer) && !World->IsNetMode(NM_ListenServer)) ||
+			World->GetAuthGameMode())
+		{
+			return false;
+		}
+
+		if (!Settings.GameMode)
+		{
+			Settings.GameMode = AGameModeBase::StaticClass();
+		}
+
+		FActorSpawnParameters SpawnInfo;
+		SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		SpawnInfo.ObjectFlags |= RF_Transient;	  // We never want to save game modes into a map
+
+		auto* GameMode = World->SpawnActor<AGameModeBase>(Settings.GameMode, SpawnInfo);
+		World->CopyGameState(GameMode, nullptr);
+		return GameMode != nullptr;
 	}
 
-	inline void FTestSpecBase::PostDefine()
+	namespace Spec
 	{
-		AfterEach([this]() {
-			if (IsLastTest())
+		inline UWorld* FMapCache::Load(const TSoftObjectPtr<UWorld>& Map)
+		{
+			check(IsInGameThread());
+
+			const FString PackageName = Map.GetLongPackageName();
+			if (const TWeakObjectPtr<UWorld>* Cached = Maps.Find(PackageName))
 			{
-				CurrentContext = {};
+				if (Cached->IsValid())
+				{
+					return Cached->Get();
+				}
 			}
-		});
-	}
-
-	inline void FTestSpecBase::BakeDefinitions()
-	{
-		TArray<TSharedRef<FSpecDefinitionScope>> Stack;
-		Stack.Push(RootDefinitionScope.ToSharedRef());
 
-		TArray<TSharedRef<IAutomationLatentCommand>> BeforeEach;
-		TArray<TSharedRef<IAutomationLatentCommand>> AfterEach;
+			UPackage* const Package = LoadPackage(nullptr, *PackageName, LOAD_None);
+			UWorld* const World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+			if (World)
+			{
+				Package->AddToRoot();
+				Maps.Add(PackageName, World);
+			}
+			return World;
+		}
 
-		while (Stack.Num() > 0)
+		inline void FMapCache::Empty()
 		{
-			const TSharedRef<FSpecDefinitionScope> Scope = Stack.Last();
-
-			BeforeEach.Append(Scope->BeforeEach);
-			// ScopeAfter each are added reversed
-			AfterEach.Reserve(AfterEach.Num() + Scope->AfterEach.Num());
-			for (int32 i = Scope->AfterEach.Num() - 1; i >= 0; --i)
+			for (const auto& Map : Maps)
 			{
-				AfterEach.Add(Scope->AfterEach[i]);
+				if (UWorld* World = Map.Value.Get())
+				{
+					World->GetOutermost()->RemoveFromRoot();
+				}
 			}
+			Maps.Empty();
+		}
 
-			for (int32 ItIndex = 0; ItIndex < Scope->It.Num(); ItIndex++)
+#if WITH_EDITOR
+		inline void FPersistentPIE::End()
+		{
+			if (Snapshot.IsCaptured())
 			{
-				TSharedRef<Spec::FIt> It = Scope->It[ItIndex];
+				Snapshot.Reset();
+				FEditorPromotionTestUtilities::EndPIE();
+			}
+		}
+#endif
+
+		inline void FWorldSnapshot::Capture(UWorld* InWorld)
+		{
+			check(IsInGameThread());
 
-				TSharedRef<FSpec> Spec = MakeShared<FSpec>();
-				Spec->Id = It->Id;
-				Spec->Description = It->Description;
-				Spec->Filename = It->Filename;
-				Spec->LineNumber = It->LineNumber;
-				Spec->Commands.Append(BeforeEach);
-				Spec->Commands.Add(It->Command);
+			Reset();
+			World = InWorld;
 
-				// Add after each reversed
-				for (int32 i = AfterEach.Num() - 1; i >= 0; --i)
+			TArray<UActorComponent*> Components;
+			for (FActorIterator ActorIt(InWorld); ActorIt; ++ActorIt)
+			{
+				AActor* const Actor = *ActorIt;
+				FActorState& State = Actors.AddDefaulted_GetRef();
+				State.Actor = Actor;
+				FSnapshotWriter ActorWriter(*this, Actor, State.Properties);
+
+				Components.Reset();
+				Actor->GetComponents(Components);
+				for (UActorComponent* Component : Components)
 				{
-					Spec->Commands.Add(AfterEach[i]);
+					FObjectState& ComponentState = State.Components.AddDefaulted_GetRef();
+					ComponentState.Object = Component;
+					FSnapshotWriter ComponentWriter(*this, Component, ComponentState.Properties);
 				}
+				CapturedActors.Add(Actor);
+			}
+			ReferenceIndices.Empty();
+		}
+
+		inline bool FWorldSnapshot::Restore()
+		{
+			check(IsInGameThread());
 
-				check(!IdToSpecMap.Contains(Spec->Id));
-				IdToSpecMap.Add(Spec->Id, Spec);
+			UWorld* const RestoredWorld = World.Get();
+			if (!IsValid(RestoredWorld))
+			{
+				return false;
 			}
-			Scope->It.Empty();
 
-			if (Scope->Children.Num() > 0)
+			for (FActorIterator ActorIt(RestoredWorld); ActorIt; ++ActorIt)
 			{
-				Stack.Append(Scope->Children);
-				Scope->Children.Empty();
+				if (!CapturedActors.Contains(*ActorIt))
+				{
+					ActorIt->Destroy();
+				}
 			}
-			else
+
+			bool bRestoredAll = true;
+			TArray<UActorComponent*> Components;
+			for (FActorState& State : Actors)
 			{
-				while (Stack.Num() > 0 && Stack.Last()->Children.Num() == 0 && Stack.Last()->It.Num() == 0)
+				AActor* const Actor = State.Actor.Get();
+				if (!IsValid(Actor))
 				{
-					const TSharedRef<FSpecDefinitionScope> PoppedScope = Stack.Pop();
+					bRestoredAll = false;
+					continue;
+				}
 
-					if (PoppedScope->BeforeEach.Num() > 0)
+				// New components go before properties are restored, so that they don't reference them
+				Components.Reset();
+				Actor->GetComponents(Components);
+				for (UActorComponent* Component : Components)
+				{
+					const bool bCaptured =
+						State.Components.ContainsByPredicate([Component](const FObjectState& Captured) {
+							return Captured.Object.Get() == Component;
+						});
+					if (!bCaptured)
 					{
-						BeforeEach.RemoveAt(
-							BeforeEach.Num() - PoppedScope->BeforeEach.Num(), PoppedScope->BeforeEach.Num());
+						Component->DestroyComponent();
 					}
+				}
 
-					if (PoppedScope->AfterEach.Num() > 0)
+				FSnapshotReader ActorReader(*this, Actor, State.Properties);
+				for (FObjectState& ComponentState : State.Components)
+				{
+					if (UObject* const Component = ComponentState.Object.Get())
 					{
-						AfterEach.RemoveAt(
-							AfterEach.Num() - PoppedScope->AfterEach.Num(), PoppedScope->AfterEach.Num());
+						FSnapshotReader ComponentReader(*this, Component, ComponentState.Properties);
 					}
 				}
+				Actor->UpdateComponentTransforms();
 			}
+			return bRestoredAll;
 		}
 
-		RootDefinitionScope.Reset();
-		DefinitionScopeStack.Reset();
-		bHasBeenDefined = true;
-	}
-
-	inline void FTestSpecBase::Redefine()
-	{
-		Description.Empty();
-		IdToSpecMap.Empty();
-		RootDefinitionScope.Reset();
-		DefinitionScopeStack.Empty();
-		bHasBeenDefined = false;
-	}
-
-	inline FString FTestSpecBase::GetDescription() const
-	{
-		FString CompleteDescription;
-		for (int32 Index = 0; Index < Description.Num(); ++Index)
+		inline void FWorldSnapshot::Reset()
 		{
-			if (Description[Index].IsEmpty())
-			{
-				continue;
-			}
+			World.Reset();
+			Actors.Empty();
+			CapturedActors.Empty();
+			References.Empty();
+			ReferenceIndices.Empty();
+		}
 
-			if (CompleteDescription.IsEmpty())
-			{
-				CompleteDescription = Description[Index];
-			}
-			else if (FChar::IsWhitespace(CompleteDescription[CompleteDescription.Len() - 1]) ||
-					 FChar::IsWhitespace(Description[Index][0]))
-			{
-				CompleteDescription = CompleteDescription + TEXT(".") + Description[Index];
-			}
-			else
+		inline FArchive& FWorldSnapshot::FSnapshotWriter::operator<<(UObject*& Value)
+		{
+			int32 Index = INDEX_NONE;
+			if (Value)
 			{
-				CompleteDescription =
-					FString::Printf(TEXT("%s.%s"), *CompleteDescription, *Description[Index]);
+				if (const int32* Found = Snapshot.ReferenceIndices.Find(Value))
+				{
+					Index = *Found;
+				}
+				else
+				{
+					Index = Snapshot.References.Add(Value);
+					Snapshot.ReferenceIndices.Add(Value, Index);
+				}
 			}
+			*this << Index;
+			return *this;
 		}
 
-		return CompleteDescription;
-	}
+		inline FArchive& FWorldSnapshot::FSnapshotReader::operator<<(UObject*& Value)
+		{
+			int32 Index = INDEX_NONE;
+			*this << Index;
+			Value = Snapshot.References.IsValidIndex(Index) ? Snapshot.References[Index].Get() : nullptr;
+			return *this;
+		}
 
-	inline FString FTestSpecBase::GetId() const
-	{
-		if (Description.Last().EndsWith(TEXT("]")))
+		inline UWorld* FWorldPool::Acquire(FTestSpec& Spec, const FTestWorldSettings& Settings)
 		{
-			FString ItDescription = Description.Last();
-			ItDescription.RemoveAt(ItDescription.Len() - 1);
+			check(IsInGameThread());
 
-			int32 StartingBraceIndex = INDEX_NONE;
-			if (ItDescription.FindLastChar(TEXT('['), StartingBraceIndex) &&
-				StartingBraceIndex != ItDescription.Len() - 1)
+			Worlds.RemoveAll([](const FPooledWorld& Pooled) {
+				return !Pooled.World.IsValid();
+			});
+
+			for (FPooledWorld& Pooled : Worlds)
 			{
-				FString CommandId = ItDescription.RightChop(StartingBraceIndex + 1);
-				return CommandId;
+				if (!Pooled.bInUse && Pooled.Settings == Settings)
+				{
+					Pooled.bInUse = true;
+					return Pooled.World.Get();
+				}
 			}
+
+			FPooledWorld& Pooled = Worlds.AddDefaulted_GetRef();
+			Pooled.Settings = Settings;
+			Pooled.World = Spec.CreateWorld(Settings);
+			Pooled.Snapshot.Capture(Pooled.World.Get());
+			Pooled.bInUse = true;
+			return Pooled.World.Get();
 		}
 
-		FString CompleteId;
-		for (int32 Index = 0; Index < Description.Num(); ++Index)
+		inline bool FWorldPool::Release(UWorld* World)
 		{
-			if (Description[Index].IsEmpty())
+			check(IsInGameThread());
+
+			const int32 PooledIndex = Worlds.IndexOfByPredicate([World](const FPooledWorld& Pooled) {
+				return Pooled.bInUse && Pooled.World.Get() == World;
+			});
+			if (PooledIndex == INDEX_NONE)
 			{
-				continue;
+				return false;
 			}
 
-			if (CompleteId.IsEmpty())
+			FPooledWorld* const Pooled = &Worlds[PooledIndex];
+			if (!Pooled->Snapshot.Restore())
 			{
-				CompleteId = Description[Index];
+				// Can't be handed out again. The caller destroys it
+				Worlds.RemoveAt(PooledIndex);
+				return false;
 			}
-			else if (FChar::IsWhitespace(CompleteId[CompleteId.Len() - 1]) ||
-					 FChar::IsWhitespace(Description[Index][0]))
+			World->SetShouldTick(Pooled->Settings.bShouldTick);
+
+			Pooled->bInUse = false;
+			Pooled->LastRelease = ++NumReleases;
+
+			int32 NumIdle = 0;
+			for (const FPooledWorld& Other : Worlds)
 			{
-				CompleteId = CompleteId + Description[Index];
+				NumIdle += Other.bInUse ? 0 : 1;
 			}
-			else
+			for (; NumIdle > MaxIdleWorlds; --NumIdle)
 			{
-				CompleteId = FString::Printf(TEXT("%s %s"), *CompleteId, *Description[Index]);
+				DestroyLeastRecentlyUsed();
 			}
+			return true;
 		}
 
-		return CompleteId;
-	}
-
-	inline void FTestSpec::PreDefine()
-	{
-		FTestSpecBase::PreDefine();
-
-		if (!bUseWorld)
+		inline void FWorldPool::Empty()
 		{
-			return;
+			for (int32 Index = Worlds.Num() - 1; Index >= 0; --Index)
+			{
+				if (!Worlds[Index].bInUse)
+				{
+					FTestSpec::DestroyWorld(Worlds[Index].World.Get());
+					Worlds.RemoveAt(Index);
+				}
+			}
 		}
 
-		LatentBeforeEach(EAsyncExecution::TaskGraphMainThread, [this](const auto Done) {
-			PrepareTestWorld([this, Done](UWorld* InWorld) {
-				MainWorld = InWorld;
-				Done.Execute();
-			});
-		});
-	}
+		inline void FWorldPool::DestroyLeastRecentlyUsed()
+		{
+			int32 OldestIndex = INDEX_NONE;
+			for (int32 Index = 0; Index < Worlds.Num(); ++Index)
+			{
+				const FPooledWorld& Pooled = Worlds[Index];
+				if (!Pooled.bInUse &&
+					(OldestIndex == INDEX_NONE || Pooled.LastRelease < Worlds[OldestIndex].LastRelease))
+				{
+					OldestIndex = Index;
+				}
+			}
 
-	inline void FTestSpec::PostDefine()
-	{
-		AfterEach([this]() {
-			// If this spec initialized a PIE world, tear it down
-			if (!bReuseWorldForAllTests || IsLastTest())
+			if (OldestIndex != INDEX_NONE)
 			{
-				ReleaseTestWorld(MainWorld.Get());
+				FTestSpec::DestroyWorld(Worlds[OldestIndex].World.Get());
+				Worlds.RemoveAt(OldestIndex);
 			}
-		});
+		}
 
-		FTestSpecBase::PostDefine();
-	}
+		inline void FRegister::DefineSpecsInParallel()
+		{
+			check(IsInGameThread());
 
-	inline void FTestSpec::PrepareTestWorld(TFunction<void(UWorld* World)> OnWorldReady)
-	{
-		checkf(IsInGameThread(), TEXT("PrepareTestWorld can only be run on game thread."));
+			// Specs get constructed here, as registering tests to the framework is not thread safe
+			TArray<FTestSpecBase*> ParallelSpecs;
+			for (FEntry* Entry : Entries())
+			{
+#if AUTOMATRON_LAZY_SPECS
+				FTestSpecBase* const Spec = Entry->GetSpecToDefine();
+#else
+				FTestSpecBase* const Spec = Entry;
+#endif
+				if (!Spec || Spec->bHasBeenDefined)
+				{
+					continue;
+				}
 
-		UWorld* SelectedWorld = FindGameWorld();
+				if (Spec->bDefineOnGameThread)
+				{
+					Spec->EnsureDefinitions();
+				}
+				else
+				{
+					ParallelSpecs.Add(Spec);
+				}
+			}
+
+			ParallelFor(
+				ParallelSpecs.Num(),
+				[&ParallelSpecs](int32 Index) {
+					ParallelSpecs[Index]->EnsureDefinitions();
+				},
+				EParallelForFlags::Unbalanced);
+		}
 
+		inline FManifest::FManifest()
+			: FManifest(FPaths::Combine(FPaths::ProjectIntermediateDir(), TEXT("Automatron")))
+		{
 #if WITH_EDITOR
-		// If there was no PIE world, start it and try again
-		if (bCanUsePIEWorld && !SelectedWorld && GIsEditor)
+			// Saved when exiting too, as listing tests doesn't run them. Only the editor saves, since
+			// other builds may be packaged or have no intermediate folder to write to
+			FAutomationTestFramework::Get().PostTestingEvent.AddRaw(this, &FManifest::Save);
+			FCoreDelegates::OnPreExit.AddRaw(this, &FManifest::Save);
+#endif
+		}
+
+		inline bool FManifest::FindTests(const FSpecInfo& Info, TArray<FTest>& OutTests, bool& bOutCacheable)
 		{
-			PIEStartedHandle =
-				FEditorDelegates::PostPIEStarted.AddLambda([this, OnWorldReady](const bool bIsSimulating) {
-					UWorld* SelectedWorld = FindGameWorld();
-					bInitializedPIE = SelectedWorld != nullptr;
-					bInitializedWorld = bInitializedPIE;
+			const FModuleFile* File = FindModuleFile(Info);
+			if (!File)
+			{
+				return false;
+			}
 
-					OnWorldReady(SelectedWorld);
-				});
-			FEditorPromotionTestUtilities::StartPIE(false);
-			return;
+			const FString ClassName{Info.ClassName};
+			if (const TArray<uint8>* Record = File->NewRecords.Find(ClassName))
+			{
+				return ReadRecord(Record->GetData(), Record->Num(), OutTests, bOutCacheable);
+			}
+			if (const TPair<int64, int64>* Record = File->MappedRecords.Find(ClassName))
+			{
+				return ReadRecord(
+					File->MappedRegion->GetMappedPtr() + Record->Key, Record->Value, OutTests, bOutCacheable);
+			}
+			return false;
+		}
+
+		inline void FManifest::AddTests(const FSpecInfo& Info, TArray<FTest>* Tests)
+		{
+			FModuleFile* File = FindModuleFile(Info);
+			if (!File)
+			{
+				return;
+			}
+
+			FString ClassName{Info.ClassName};
+			int32 NumTests = Tests ? Tests->Num() : INDEX_NONE;
+
+			TArray<uint8>& Record = File->NewRecords.FindOrAdd(ClassName);
+			Record.Reset();
+			FMemoryWriter Writer{Record};
+			Writer << ClassName << NumTests;
+			if (Tests)
+			{
+				for (FTest& Test : *Tests)
+				{
+					Writer << Test;
+				}
+			}
 		}
-#endif
 
-		if (!SelectedWorld)
+		inline void FManifest::Save()
 		{
-			SelectedWorld = CreateWorld(DefaultWorldSettings);
-			bInitializedWorld = true;
-		}
+			if (!IFileManager::Get().MakeDirectory(*Directory, true))
+			{
+				UE_LOG(LogAutomatron, Verbose, TEXT("Can't write the test manifest to %s"), *Directory);
+				return;
+			}
 
-		OnWorldReady(SelectedWorld);
-	}
+			for (auto& Module : Modules)
+			{
+				SaveFile(Module.Value);
+			}
+		}
 
-	inline void FTestSpec::ReleaseTestWorld(UWorld* World)
-	{
-		if (!IsInGameThread())
+		inline FManifest::FModuleFile* FManifest::FindModuleFile(const FSpecInfo& Info)
 		{
-			AsyncTask(ENamedThreads::GameThread, [this, World]() {
-				ReleaseTestWorld(World);
-			});
-			return;
+			if (!Info.ModuleName)
+			{
+				return nullptr;
+			}
+
+			const FString ModuleName{Info.ModuleName};
+			if (FModuleFile* File = Modules.Find(ModuleName))
+			{
+				return File->Stamp.IsEmpty() ? nullptr : File;
+			}
+
+			FModuleFile& File = Modules.Add(ModuleName);
+			File.Path = FPaths::Combine(Directory, ModuleName + TEXT(".TestManifest.bin"));
+			File.Stamp = GetModuleStamp(Info.ModuleName);
+			if (File.Stamp.IsEmpty())
+			{
+				return nullptr;
+			}
+			LoadFile(File);
+			return &File;
 		}
 
-#if WITH_EDITOR
-		FEditorDelegates::PostPIEStarted.Remove(PIEStartedHandle);
-		if (bInitializedPIE)
+		inline void FManifest::LoadFile(FModuleFile& File)
 		{
-			FEditorPromotionTestUtilities::EndPIE();
-			bInitializedPIE = false;
-			bInitializedWorld = false;
-			return;
+			File.MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*File.Path));
+			if (File.MappedFile)
+			{
+				File.MappedRegion.Reset(File.MappedFile->MapRegion());
+			}
+			if (!File.MappedRegion)
+			{
+				UnloadFile(File);
+				return;
+			}
+
+			VisitRecords(File.MappedRegion->GetMappedPtr(), File.MappedRegion->GetMappedSize(), File.Stamp,
+				[&File](const FString& ClassName, int64 Offset, int64 Size) {
+					File.MappedRecords.Add(ClassName, {Offset, Size});
+				});
+			if (File.MappedRecords.Num() <= 0)
+			{
+				// Saved for another binary, or empty. Nothing to keep it mapped for
+				UnloadFile(File);
+			}
 		}
-#endif
 
-		if (!bInitializedWorld)
+		inline void FManifest::UnloadFile(FModuleFile& File)
 		{
-			return;
+			File.MappedRecords.Empty();
+			File.MappedRegion.Reset();
+			File.MappedFile.Reset();
 		}
 
-		// If world is not PIE, we take care of its teardown
-		DestroyWorld(World);
-		bInitializedWorld = false;
-	}
-
-	inline UWorld* FTestSpec::CreateWorld(FTestWorldSettings Settings)
-	{
-		auto* GameInstance = CreateGameInstance(Settings, GEngine);
-		GameInstance->AddToRoot();
-
-		GameInstance->InitializeStandalone(TEXT("FAbilitySpec::World"), nullptr);
-		UWorld* World = GameInstance->GetWorld();
-
-		const bool bInformEngineOfWorld = true;
-		if (GEngine && bInformEngineOfWorld)
+		inline void FManifest::SaveFile(FModuleFile& File)
 		{
-			GEngine->WorldAdded(World);
-		}
+			if (File.NewRecords.Num() <= 0)
+			{
+				return;
+			}
 
-		World->SetShouldTick(Settings.bShouldTick);
-		SetGameMode(World, Settings);
+			TArray<uint8> Data;
+			FMemoryWriter Writer{Data};
+			uint32 FileMagic = Magic;
+			int32 FileVersion = Version;
+			int32 NumRecords = 0;
+			Writer << FileMagic << FileVersion << File.Stamp;
+			const int64 NumRecordsOffset = Writer.Tell();
+			Writer << NumRecords;
+
+			auto WriteRecord = [&Writer, &NumRecords](const uint8* RecordData, int64 Size) {
+				Writer << Size;
+				Writer.Serialize(const_cast<uint8*>(RecordData), Size);
+				++NumRecords;
+			};
+			// Only mapped records were saved for the current binary
+			for (const auto& Record : File.MappedRecords)
+			{
+				if (!File.NewRecords.Contains(Record.Key))
+				{
+					WriteRecord(File.MappedRegion->GetMappedPtr() + Record.Value.Key, Record.Value.Value);
+				}
+			}
+			for (const auto& Record : File.NewRecords)
+			{
+				WriteRecord(Record.Value.GetData(), Record.Value.Num());
+			}
 
-		FURL URL;
-		World->InitializeActorsForPlay(URL);
-		World->BeginPlay();
+			Writer.Seek(NumRecordsOffset);
+			Writer << NumRecords;
 
-		World->AddToRoot();
-		return World;
-	}
+			// The file can't be replaced while mapped
+			UnloadFile(File);
+			if (!FFileHelper::SaveArrayToFile(Data, *File.Path))
+			{
+				UE_LOG(LogAutomatron, Warning, TEXT("Couldn't save the test manifest to '%s'"), *File.Path);
+			}
+			File.NewRecords.Empty();
+			LoadFile(File);
+		}
 
-	inline void FTestSpec::TickWorldUntil(UWorld* World, bool bUseRealtime, TFunction<bool(float)> Delegate)
-	{
-		check(IsInGameThread());
+		inline FString FManifest::GetModuleStamp(const ANSICHAR* ModuleName)
+		{
+			// Monolithic builds link every module into the executable
+			FString Path = FModuleManager::Get().GetModuleFilename(FName(ModuleName));
+			if (Path.IsEmpty())
+			{
+				Path = FPlatformProcess::ExecutablePath();
+			}
 
-		const float Step = 1.f / 60.f;	  // 60 fps
+			IFileManager& FileManager = IFileManager::Get();
+			const int64 Size = FileManager.FileSize(*Path);
+			if (Size < 0)
+			{
+				return {};
+			}
+			return FString::Printf(TEXT("%lld-%lld"), FileManager.GetTimeStamp(*Path).GetTicks(), Size);
+		}
 
-		if (!bUseRealtime)
+		inline bool FManifest::ReadRecord(
+			const uint8* Data, int64 Size, TArray<FTest>& OutTests, bool& bOutCacheable)
 		{
-			while (IsValid(World) && Delegate(Step))
+			FBufferReader Reader{const_cast<uint8*>(Data), Size, false};
+			FString ClassName;
+			int32 NumTests = 0;
+			Reader << ClassName << NumTests;
+			if (Reader.IsError() || NumTests > Size)
 			{
-				World->Tick(ELevelTick::LEVELTICK_All, Step);
+				return false;
+			}
 
-				// This is terrible but required for subticking like this.
-				// we could always cache the real GFrameCounter at the start of our tests
-				// and restore it when finished.
-				++GFrameCounter;
+			bOutCacheable = NumTests != INDEX_NONE;
+			OutTests.SetNum(FMath::Max(NumTests, 0));
+			for (FTest& Test : OutTests)
+			{
+				Reader << Test;
 			}
-			return;
+			return !Reader.IsError();
 		}
 
-		float DeltaTime = Step;
-		while (IsValid(World) && Delegate(DeltaTime))
+		inline void FManifest::VisitRecords(const uint8* Data, int64 Size, const FString& Stamp,
+			TFunctionRef<void(const FString& ClassName, int64 Offset, int64 Size)> Visitor)
 		{
-			int32 TickCycles = 0;
-			CLOCK_CYCLES(TickCycles);
-			World->Tick(ELevelTick::LEVELTICK_All, DeltaTime);
-			UNCLOCK_CYCLES(TickCycles);
-
-			// This is terrible but required for subticking like this.
-			// we could always cache the real GFrameCounter at the start of our tests
-			// and restore it when finished.
-			++GFrameCounter;
+			if (!Data)
+			{
+				return;
+			}
 
-			const float TickDuration = FPlatformTime::ToSeconds(TickCycles);
-			if (TickDuration < Step)
+			FBufferReader Reader{const_cast<uint8*>(Data), Size, false};
+			uint32 FileMagic = 0;
+			int32 FileVersion = 0;
+			FString FileStamp;
+			int32 NumRecords = 0;
+			Reader << FileMagic << FileVersion;
+			if (Reader.IsError() || FileMagic != Magic || FileVersion != Version)
 			{
-				FPlatformProcess::Sleep(Step - TickDuration);
+				return;
+			}
+			Reader << FileStamp << NumRecords;
+			if (Reader.IsError() || !FileStamp.Equals(Stamp, ESearchCase::CaseSensitive))
+			{
+				return;
 			}
 
-			DeltaTime = FMath::Max(TickDuration, Step);
-		}
-	}
+			FString ClassName;
+			for (int32 Index = 0; Index < NumRecords; ++Index)
+			{
+				int64 RecordSize = 0;
+				Reader << RecordSize;
+				const int64 RecordOffset = Reader.Tell();
+				Reader << ClassName;
+				if (Reader.IsError() || RecordSize < 0 || RecordOffset + RecordSize > Size)
+				{
+					return;
+				}
 
-	inline void FTestSpec::TickWorld(UWorld* World, float Duration, bool bUseRealtime)
-	{
-		TickWorldUntil(World, bUseRealtime, [&Duration](float DeltaTime) {
-			Duration -= DeltaTime;
-			return Duration > 0.f;
-		});
-	}
+				Visitor(ClassName, RecordOffset, RecordSize);
+				Reader.Seek(RecordOffset + RecordSize);
+			}
+		}
 
-	inline UGameInstance* FTestSpec::CreateGameInstance(const FTestWorldSettings& Settings, UObject* Context)
-	{
-		UClass* GameInstanceClass = Settings.GameInstance.Get();
-		if (!GameInstanceClass)
+		inline bool FLazySpec::RunTest(const FString& InParameters)
 		{
-			FSoftClassPath GameInstanceClassName = GetDefault<UGameMapsSettings>()->GameInstanceClass;
-			GameInstanceClass = GameInstanceClassName.TryLoadClass<UGameInstance>();
+			FTestSpec& RunningSpec = GetSpec();
+			RunningSpec.ClearExecutionInfo();
+
+			const bool bResult = RunningSpec.RunTest(InParameters);
+			if (RunningSpec.WasLastRunQueued())
+			{
+				// Report once the queued commands of the spec are done
+				FAutomationTestFramework::Get().EnqueueLatentCommand(
+					MakeShared<FFunctionLatentCommand>([this]() {
+						ForwardEvents();
+						return true;
+					}));
+			}
+			else
+			{
+				ForwardEvents();
+			}
+			return bResult;
 		}
 
-		if (!GameInstanceClass)
+		// FTestSpec hides these overloads, so they are called through FTestSpecBase
+		inline FString FLazySpec::GetTestSourceFileName(const FString& InTestName) const
 		{
-			GameInstanceClass = UGameInstance::StaticClass();
+			if (UseManifest())
+			{
+				const FManifest::FTest* Test = FindManifestTest(InTestName);
+				return Test ? Test->FileName : GetTestSourceFileName();
+			}
+			return static_cast<const FTestSpecBase&>(GetSpec()).GetTestSourceFileName(InTestName);
 		}
-		return NewObject<UGameInstance>(Context, GameInstanceClass);
-	}
 
-	inline bool FTestSpec::DestroyWorld(UWorld* World)
-	{
-		// If world is not PIE, we take care of its teardown
-		if (World && !World->IsPlayInEditor())
+		inline int32 FLazySpec::GetTestSourceFileLine(const FString& InTestName) const
 		{
-			World->BeginTearingDown();
-
-			// Cancel any pending connection to a server
-			GEngine->CancelPending(World);
-
-			// Shut down any existing game connections
-			GEngine->ShutdownWorldNetDriver(World);
-
-			for (FActorIterator ActorIt(World); ActorIt; ++ActorIt)
+			if (UseManifest())
 			{
-				ActorIt->RouteEndPlay(EEndPlayReason::Quit);
+				const FManifest::FTest* Test = FindManifestTest(InTestName);
+				return Test ? Test->LineNumber : GetTestSourceFileLine();
 			}
+			return static_cast<const FTestSpecBase&>(GetSpec()).GetTestSourceFileLine(InTestName);
+		}
 
-			if (auto* GameInstance = World->GetGameInstance())
+		inline void FLazySpec::GetTests(
+			TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+		{
+			if (UseManifest())
 			{
-				GameInstance->Shutdown();
-				GameInstance->RemoveFromRoot();
+				OutBeautifiedNames.Reserve(OutBeautifiedNames.Num() + ManifestTests.Num());
+				OutTestCommands.Reserve(OutTestCommands.Num() + ManifestTests.Num());
+				for (const FManifest::FTest& Test : ManifestTests)
+				{
+					OutBeautifiedNames.Add(Test.Description);
+					OutTestCommands.Add(Test.Id);
+				}
+				return;
 			}
 
-			GEngine->DestroyWorldContext(World);
-			World->DestroyWorld(false);
+			const int32 FirstTest = OutTestCommands.Num();
+			GetSpec().GetTests(OutBeautifiedNames, OutTestCommands);
+#if AUTOMATRON_TEST_MANIFEST
+			if (!bInManifest)
+			{
+				AddToManifest(OutBeautifiedNames, OutTestCommands, FirstTest);
+			}
+#endif
+		}
 
-			return true;
+		inline void FLazySpec::AddError(const FString& InError, int32 StackOffset)
+		{
+			if (Spec)
+			{
+				Spec->AddError(InError, StackOffset + 1);
+			}
+			else
+			{
+				FAutomationTestBase::AddError(InError, StackOffset + 1);
+			}
 		}
-		return false;
-	}
 
-	inline UWorld* FTestSpec::FindGameWorld()
-	{
-		const TIndirectArray<FWorldContext>& WorldContexts = GEngine->GetWorldContexts();
-		for (const FWorldContext& Context : WorldContexts)
+		inline void FLazySpec::AddWarning(const FString& InWarning, int32 StackOffset)
 		{
-			if (Context.World() != nullptr)
+			if (Spec)
 			{
-				if (Context.WorldType == EWorldType::PIE /*&& Context.PIEInstance == 0*/)
-				{
-					return Context.World();
-				}
+				Spec->AddWarning(InWarning, StackOffset + 1);
+			}
+			else
+			{
+				FAutomationTestBase::AddWarning(InWarning, StackOffset + 1);
+			}
+		}
 
-				if (Context.WorldType == EWorldType::Game)
-				{
-					return Context.World();
-				}
+		inline FTestSpec& FLazySpec::GetSpec() const
+		{
+			if (!Spec)
+			{
+				Spec.Reset(Factory());
+				ManifestTests.Empty();
 			}
+			return *Spec;
 		}
-		return nullptr;
-	}
 
-	inline bool FTestSpec::SetGameMode(UWorld* World, FTestWorldSettings& Settings)
-	{
-		if ((!World->IsNetMode(NM_DedicatedServer) && !World->IsNetMode(NM_ListenServer)) ||
-			World->GetAuthGameMode())
+		inline bool FLazySpec::UseManifest() const
 		{
+#if AUTOMATRON_TEST_MANIFEST
+			if (!bReadManifest)
+			{
+				bReadManifest = true;
+				bInManifest = FManifest::Get().FindTests(Info, ManifestTests, bCacheable);
+			}
+			return bInManifest && bCacheable && !Spec;
+#else
 			return false;
+#endif
 		}
 
-		if (!Settings.GameMode)
+		inline const FManifest::FTest* FLazySpec::FindManifestTest(const FString& InTestName) const
 		{
-			Settings.GameMode = AGameModeBase::StaticClass();
+			const FStringView Id = GetTestIdFromName(InTestName, TestName);
+			return ManifestTests.FindByPredicate([Id](const FManifest::FTest& Test) {
+				return Id.Equals(Test.Id, ESearchCase::IgnoreCase);
+			});
 		}
 
-		FActorSpawnParameters SpawnInfo;
-		SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-		SpawnInfo.ObjectFlags |= RF_Transient;	  // We never want to save game modes into a map
+		inline void FLazySpec::AddToManifest(const TArray<FString>& BeautifiedNames,
+			const TArray<FString>& TestCommands, int32 FirstTest) const
+		{
+			bInManifest = true;
+			if (!Spec->CanCacheTests())
+			{
+				FManifest::Get().AddTests(Info, nullptr);
+				return;
+			}
 
-		auto* GameMode = World->SpawnActor<AGameModeBase>(Settings.GameMode, SpawnInfo);
-		World->CopyGameState(GameMode, nullptr);
-		return GameMode != nullptr;
-	}
+			const FTestSpecBase& SpecBase = *Spec;
+			TArray<FManifest::FTest> Tests;
+			Tests.Reserve(TestCommands.Num() - FirstTest);
+			for (int32 Index = FirstTest; Index < TestCommands.Num(); ++Index)
+			{
+				const FString& Id = TestCommands[Index];
+				Tests.Add({Id, BeautifiedNames[Index], SpecBase.GetTestSourceFileName(Id),
+					SpecBase.GetTestSourceFileLine(Id)});
+			}
+			FManifest::Get().AddTests(Info, &Tests);
+		}
+
+		inline void FLazySpec::ForwardEvents()
+		{
+			// Errors the spec expected but didn't happen are added as errors
+			Spec->HasMetExpectedErrors();
+
+			FAutomationTestExecutionInfo SpecInfo;
+			Spec->GetExecutionInfo(SpecInfo);
+			for (const FAutomationExecutionEntry& Entry : SpecInfo.GetEntries())
+			{
+				AddEvent(Entry.Event);
+			}
+		}
+	}	 // namespace Spec
 
 	template <uint32 TFlags>
 	inline void FTestSpec::Setup(
-		FString&& InName, FString&& InPrettyName, FString&& InFileName, int32 InLineNumber)
+		FString&& InName, FString&& InPrettyName, FString&& InFileName, int32 InLineNumber, bool bRegister)
 	{
 		static_assert(TFlags & EAutomationTestFlags::ApplicationContextMask,
 			"AutomationTest has no application flag. It shouldn't run. See "
@@ -1461,6 +5292,78 @@ namespace Automatron
 		LineNumber = InLineNumber;
 		Flags = TFlags;
 
-		Reregister(InName);
+		if (bRegister)
+		{
+			Reregister(InName);
+		}
+		else
+		{
+			// Its lazy entry is registered instead
+			FAutomationTestFramework::Get().UnregisterAutomationTest(TestName);
+			TestName = InName;
+		}
 	}
 }	 // namespace Automatron
+
+
+////////////////////////////////////////////////////////////////
+// IMPLEMENTATION
+// Compiled once, by the source file defining AUTOMATRON_IMPLEMENTATION
+
+#if defined(AUTOMATRON_IMPLEMENTATION)
+DEFINE_LOG_CATEGORY(LogAutomatron);
+
+namespace Automatron
+{
+	// Singletons are defined here instead of inline, so that specs of every module share them
+	namespace Spec
+	{
+		FWorkerPool& FWorkerPool::Get()
+		{
+			static FWorkerPool WorkerPool;
+			return WorkerPool;
+		}
+
+		FStuckWorkers& FStuckWorkers::Get()
+		{
+			static FStuckWorkers StuckWorkers;
+			return StuckWorkers;
+		}
+
+		FManifest& FManifest::Get()
+		{
+			static FManifest Manifest;
+			return Manifest;
+		}
+
+		FWorldPool& FWorldPool::Get()
+		{
+			static FWorldPool Pool;
+			return Pool;
+		}
+
+		FMapCache& FMapCache::Get()
+		{
+			static FMapCache Cache;
+			return Cache;
+		}
+
+#if WITH_EDITOR
+		FPersistentPIE& FPersistentPIE::Get()
+		{
+			static FPersistentPIE PersistentPIE;
+			return PersistentPIE;
+		}
+#endif
+	}	 // namespace Spec
+
+	namespace Commands
+	{
+		FLatentScheduler& FLatentScheduler::Get()
+		{
+			static FLatentScheduler Scheduler;
+			return Scheduler;
+		}
+	}	 // namespace Commands
+}	 // namespace Automatron
+#endif
@@ -10,6 +10,9 @@ public class AutomatronTest : ModuleRules
 		bEnforceIWYU = true;
         bLegacyPublicIncludePaths = false;
 
+		// Coroutine blocks need C++20
+		CppStandard = CppStandardVersion.Cpp20;
+
         PublicDependencyModuleNames.AddRange(new string[] {
 			"Core",
 		});
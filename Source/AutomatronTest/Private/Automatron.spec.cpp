@@ -2,12 +2,143 @@
 
 #include <CoreMinimal.h>
 #include <Misc/AutomationTest.h>
+#include <TimerManager.h>
 
 #include "Automatron.h"
 
 
 #if WITH_DEV_AUTOMATION_TESTS
 
+namespace
+{
+	// Spec with a latent test declared before an inline one, used to check execution orders
+	class FExecutionOrderSpec : public Automatron::FTestSpecBase
+	{
+	public:
+		FExecutionOrderSpec(Automatron::Spec::EExecutionOrder InExecutionOrder)
+		{
+			ExecutionOrder = InExecutionOrder;
+		}
+
+		// @return ids of the tests in the order they would run
+		TArray<FString> GetPlannedIds() const
+		{
+			EnsureDefinitions();
+
+			TArray<int32> Plan;
+			for (int32 SpecIndex = 0; SpecIndex < GetNumTests(); ++SpecIndex)
+			{
+				Plan.Add(SpecIndex);
+			}
+			SortExecutionPlan(Plan);
+
+			TArray<FString> Ids;
+			for (const int32 SpecIndex : Plan)
+			{
+				Ids.Add(GetTestId(SpecIndex));
+			}
+			return Ids;
+		}
+
+		virtual uint32 GetTestFlags() const override
+		{
+			return EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter;
+		}
+
+	protected:
+		virtual FString GetBeautifiedTestName() const override
+		{
+			return TEXT("Automatron.ExecutionOrder");
+		}
+
+		virtual void Define() override
+		{
+			LatentIt("Latent", [](const FDoneDelegate& Done) {
+				Done.Execute();
+			});
+			It("Inline", []() {});
+		}
+	};
+
+	// Thread-safe spec whose tests report their index as an error, used to check reporting order
+	class FParallelSpec : public Automatron::FTestSpecBase
+	{
+	public:
+		static constexpr int32 NumTests = 16;
+
+		// Whether tests have a BeforeEach block, which keeps them off workers
+		const bool bWithBeforeEach = false;
+
+		// What each test saw while running
+		TArray<int32> Contexts;
+		TAtomic<int32> TestsOnWorkers{0};
+		int32 LastTest = INDEX_NONE;
+
+		explicit FParallelSpec(bool bInWithBeforeEach = false)
+			: bWithBeforeEach(bInWithBeforeEach)
+		{
+			bThreadSafeTests = true;
+			bEnableSkipIfError = false;
+			Contexts.SetNumZeroed(NumTests);
+		}
+
+		// @return errors reported by running all tests at once
+		TArray<FString> RunAllTests()
+		{
+			RunTest(TEXT(""));
+
+			FAutomationTestExecutionInfo Info;
+			GetExecutionInfo(Info);
+
+			TArray<FString> Errors;
+			for (const FAutomationExecutionEntry& Entry : Info.GetEntries())
+			{
+				if (Entry.Event.Type == EAutomationEventType::Error)
+				{
+					Errors.Add(Entry.Event.Message);
+				}
+			}
+			return Errors;
+		}
+
+		virtual uint32 GetTestFlags() const override
+		{
+			return EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter;
+		}
+
+	protected:
+		virtual FString GetBeautifiedTestName() const override
+		{
+			return TEXT("Automatron.Parallel");
+		}
+
+		virtual void Define() override
+		{
+			if (bWithBeforeEach)
+			{
+				BeforeEach([]() {});
+			}
+
+			for (int32 Index = 0; Index < NumTests; ++Index)
+			{
+				It(FString::Printf(TEXT("Test %d"), Index), [this, Index]() {
+					Contexts[Index] = GetCurrentContext().GetId();
+					if (!IsInGameThread())
+					{
+						++TestsOnWorkers;
+					}
+					if (IsLastTest())
+					{
+						LastTest = Index;
+					}
+					AddError(FString::FromInt(Index));
+				});
+			}
+		}
+	};
+}	 // namespace
+
+
 SPEC(FAutomatronSpec, Automatron::FTestSpec, "Automatron",
 	EAutomationTestFlags::EngineFilter |
 	EAutomationTestFlags::HighPriority |
@@ -16,6 +147,420 @@ SPEC(FAutomatronSpec, Automatron::FTestSpec, "Automatron",
 	It("Can run a test", []() {
 		// Succeed
 	});
+
+	Describe("Batching", [this]() {
+		static uint64 BeforeEachFrame = 0;
+
+		BeforeEach([]() {
+			BeforeEachFrame = GFrameCounter;
+		});
+
+		It("Runs synchronous blocks on the same frame", [this]() {
+			TestTrue(TEXT("Same frame as BeforeEach"), GFrameCounter == BeforeEachFrame);
+		});
+	});
+
+	Describe("Scopes", [this]() {
+		static TArray<int32> Order;
+
+		BeforeEach([]() {
+			Order.Reset();
+			Order.Add(1);
+		});
+
+		Describe("Nested", [this]() {
+			BeforeEach([]() {
+				Order.Add(2);
+			});
+
+			It("Runs parent BeforeEach first", [this]() {
+				TestTrue(TEXT("Order"), Order.Num() == 2 && Order[0] == 1 && Order[1] == 2);
+			});
+		});
+	});
+}
+
+
+#if AUTOMATRON_COROUTINES
+SPEC(FAutomatronCoroutineSpec, Automatron::TCoroutineSpec<Automatron::FTestSpec>, "Automatron.Coroutines",
+	EAutomationTestFlags::EngineFilter |
+	EAutomationTestFlags::HighPriority |
+	EAutomationTestFlags::EditorContext)
+{
+	CoIt("Can await ticks, conditions and futures", [this]() -> Automatron::Spec::FCoroutine {
+		const uint64 StartFrame = GFrameCounter;
+		co_await NextTick();
+		TestTrue(TEXT("Resumed on a later frame"), GFrameCounter > StartFrame);
+
+		int32 Checks = 0;
+		co_await WaitUntil([&Checks]() {
+			return ++Checks == 3;
+		});
+		TestEqual(TEXT("Condition checks"), Checks, 3);
+
+		const int32 Value = co_await WaitFor(Async(EAsyncExecution::ThreadPool, []() {
+			return 7;
+		}));
+		TestEqual(TEXT("Future value"), Value, 7);
+	});
+}
+#endif
+
+
+class FAutomatronInlineSpec : public Automatron::FTestSpec
+{
+	GENERATE_SPEC(FAutomatronInlineSpec, "Automatron.Inline",
+		EAutomationTestFlags::EngineFilter |
+		EAutomationTestFlags::HighPriority |
+		EAutomationTestFlags::EditorContext);
+
+	FAutomatronInlineSpec()
+	{
+		bUseWorld = false;
+		bCanUsePIEWorld = false;
+	}
+};
+
+void FAutomatronInlineSpec::Define()
+{
+	It("Runs without a world", [this]() {
+		TestNull(TEXT("World"), GetMainWorld());
+	});
+
+	Describe("Block functions", [this]() {
+		It("Can hold functors too big to be stored inline", [this]() {
+			int32 Values[32] = {};
+			Values[31] = 7;
+
+			Automatron::Spec::FBlockFunction Function = [this, Values]() {
+				TestEqual(TEXT("Captured value"), Values[31], 7);
+			};
+			Automatron::Spec::FBlockFunction MovedFunction = MoveTemp(Function);
+
+			TestFalse(TEXT("Moved function is unbound"), static_cast<bool>(Function));
+			MovedFunction();
+		});
+
+		It("Can hold functors that return a value", [this]() {
+			int32 Calls = 0;
+			Automatron::Spec::FBlockFunction Function = [&Calls]() {
+				return ++Calls;
+			};
+
+			Function();
+			TestEqual(TEXT("Calls"), Calls, 1);
+		});
+	});
+
+	Describe("Names", [this]() {
+		It("Can have a custom id [CustomId]", [this]() {
+			TArray<FString> Descriptions;
+			TArray<FString> Ids;
+			GetTests(Descriptions, Ids);
+
+			TestTrue(TEXT("Custom id"), Ids.Contains(TEXT("CustomId")));
+			TestTrue(TEXT("Joined id"), Ids.Contains(TEXT("Names Can have an id made of its scopes")));
+			TestTrue(TEXT("Description"),
+				Descriptions.Contains(TEXT("Names.Can have a custom id [CustomId]")));
+		});
+
+		It("Can have an id made of its scopes", []() {});
+	});
+
+	Describe("Execution order", [this]() {
+		It("Follows declaration order by default", [this]() {
+			const FExecutionOrderSpec Spec{Automatron::Spec::EExecutionOrder::Declaration};
+			TestTrue(TEXT("Latent test first"), Spec.GetPlannedIds()[0] == TEXT("Latent"));
+		});
+
+		It("Runs inline tests first when grouped by affinity", [this]() {
+			const FExecutionOrderSpec Spec{Automatron::Spec::EExecutionOrder::Affinity};
+			TestTrue(TEXT("Inline test first"), Spec.GetPlannedIds()[0] == TEXT("Inline"));
+		});
+	});
+
+	Describe("Thread-safe specs", [this]() {
+		It("Report events of parallel tests in plan order", [this]() {
+			FParallelSpec Spec;
+			const TArray<FString> Errors = Spec.RunAllTests();
+
+			bool bInOrder = Errors.Num() == FParallelSpec::NumTests;
+			for (int32 Index = 0; bInOrder && Index < Errors.Num(); ++Index)
+			{
+				bInOrder = Errors[Index] == FString::FromInt(Index);
+			}
+			TestTrue(TEXT("All errors in plan order"), bInOrder);
+		});
+
+		It("Give each parallel test its own context", [this]() {
+			FParallelSpec Spec;
+			Spec.RunAllTests();
+
+			bool bOwnContexts = true;
+			for (int32 Index = 0; Index < FParallelSpec::NumTests; ++Index)
+			{
+				bOwnContexts &= Spec.Contexts[Index] == Index + 1;
+			}
+			TestTrue(TEXT("Contexts in plan order"), bOwnContexts);
+			TestEqual(TEXT("Last test"), Spec.LastTest, FParallelSpec::NumTests - 1);
+		});
+
+		It("Run tests with BeforeEach blocks on the game thread", [this]() {
+			FParallelSpec Spec{true};
+			Spec.RunAllTests();
+
+			TestEqual(TEXT("Tests on workers"), Spec.TestsOnWorkers.Load(), 0);
+		});
+	});
+
+	Describe("Async blocks", [this]() {
+		It("Can take a cancellation token", EAsyncExecution::ThreadPool,
+			[this](const Automatron::Spec::FCancellationToken& Token) {
+				TestFalse(TEXT("Canceled before timing out"), Token.IsCanceled());
+			});
+
+		It("Can take a generic block", EAsyncExecution::ThreadPool, [this](const auto&... Params) {
+			TestEqual(TEXT("Params"), static_cast<int32>(sizeof...(Params)), 1);
+		});
+
+		Describe("Timing out", [this]() {
+			BeforeEach([this]() {
+				AddExpectedError(TEXT("Latent command timed out."));
+			});
+
+			It("Cancels its token", EAsyncExecution::ThreadPool, FTimespan::FromMilliseconds(100),
+				[this](const Automatron::Spec::FCancellationToken& Token) {
+					// Gives up eventually, so that a token never canceled fails instead of getting stuck
+					const double GiveUpTime = FPlatformTime::Seconds() + 5.0;
+					while (!Token.IsCanceled() && FPlatformTime::Seconds() < GiveUpTime)
+					{
+						FPlatformProcess::Sleep(0.01f);
+					}
+					TestTrue(TEXT("Canceled after timing out"), Token.IsCanceled());
+				});
+		});
+
+		It("Can run on the worker pool", WorkerPool(), [this]() {
+			TestFalse(TEXT("On the game thread"), IsInGameThread());
+		});
+
+		Describe("Reporting", [this]() {
+			AfterEach([this]() {
+				FAutomationTestExecutionInfo Info;
+				GetExecutionInfo(Info);
+				TestTrue(TEXT("Info reported by the worker"),
+					Info.GetEntries().ContainsByPredicate([](const FAutomationExecutionEntry& Entry) {
+						return Entry.Event.Message == TEXT("Reported from a worker");
+					}));
+			});
+
+			It("Can report from its worker", WorkerPool(), [this]() {
+				AddInfo(TEXT("Reported from a worker"));
+			});
+		});
+
+		It("Reports in place on the game thread", EAsyncExecution::TaskGraphMainThread, [this]() {
+			AddInfo(TEXT("Reported from the game thread"));
+
+			FAutomationTestExecutionInfo Info;
+			GetExecutionInfo(Info);
+			TestTrue(TEXT("Info reported before returning"),
+				Info.GetEntries().ContainsByPredicate([](const FAutomationExecutionEntry& Entry) {
+					return Entry.Event.Message == TEXT("Reported from the game thread");
+				}));
+		});
+	});
+
+	Describe("Latent scheduler", [this]() {
+		static int32 WaitsBefore = 0;
+
+		It("Ignores blocks done for specs that aren't waiting", [this]() {
+			const FExecutionOrderSpec Other{Automatron::Spec::EExecutionOrder::Declaration};
+			Automatron::Commands::FLatentScheduler& Scheduler = Automatron::Commands::FLatentScheduler::Get();
+
+			Scheduler.Wake(Other);
+			TestTrue(TEXT("No wait latency"), Scheduler.ConsumeWaitLatency(Other) < 0.0);
+		});
+
+		Describe("Waiting", [this]() {
+			BeforeEach([this]() {
+				WaitsBefore = GetStats().LatentWaits;
+			});
+
+			LatentBeforeEach([](const FDoneDelegate& Done) {
+				AsyncTask(ENamedThreads::GameThread, [Done]() {
+					Done.Execute();
+				});
+			});
+
+			It("Resumes specs woken by a done block", [this]() {
+				TestTrue(TEXT("Latent waits"), GetStats().LatentWaits > WaitsBefore);
+			});
+		});
+	});
+
+	Describe("World pool", [this]() {
+		It("Hands released worlds to the next spec", [this]() {
+			Automatron::Spec::FWorldPool& Pool = Automatron::Spec::FWorldPool::Get();
+			Automatron::FTestWorldSettings Settings;
+			Settings.Profile = Automatron::ETestWorldProfile::LogicOnly;
+
+			UWorld* const First = Pool.Acquire(*this, Settings);
+			TestTrue(TEXT("First in use"), Pool.IsInUse(First));
+			TestTrue(TEXT("First released"), Pool.Release(First));
+			TestTrue(TEXT("Idle world owned"), Pool.Owns(First) && !Pool.IsInUse(First));
+
+			UWorld* const Second = Pool.Acquire(*this, Settings);
+			TestTrue(TEXT("Same world"), First && First == Second);
+			TestTrue(TEXT("Second released"), Pool.Release(Second));
+		});
+	});
+
+	Describe("World profiles", [this]() {
+		It("Give logic-only worlds a world context without a game instance", [this]() {
+			Automatron::FTestWorldSettings Settings;
+			Settings.Profile = Automatron::ETestWorldProfile::LogicOnly;
+			UWorld* const World = CreateWorld(Settings);
+
+			TestNotNull(TEXT("World context"), GEngine->GetWorldContextFromWorld(World));
+			TestNull(TEXT("Game instance"), World->GetGameInstance());
+
+			DestroyWorld(World);
+		});
+
+		It("Give copies of maps a game instance that knows them", [this]() {
+			Automatron::FTestWorldSettings Settings;
+			Settings.Map = TSoftObjectPtr<UWorld>(FSoftObjectPath(TEXT("/Engine/Maps/Entry.Entry")));
+			UWorld* const World = CreateWorld(Settings);
+			if (!TestNotNull(TEXT("World"), World))
+			{
+				return;
+			}
+
+			UGameInstance* const GameInstance = World->GetGameInstance();
+			TestTrue(TEXT("Game instance world"), GameInstance && GameInstance->GetWorld() == World);
+
+			DestroyWorld(World);
+		});
+	});
+
+	Describe("Map worlds", [this]() {
+		It("Are copies that don't outlive their destruction", [this]() {
+			Automatron::FTestWorldSettings Settings;
+			Settings.Map = TSoftObjectPtr<UWorld>(FSoftObjectPath(TEXT("/Engine/Maps/Entry.Entry")));
+			UWorld* const World = CreateWorld(Settings);
+			if (!TestNotNull(TEXT("World"), World))
+			{
+				return;
+			}
+			TestFalse(TEXT("Standalone or public"), World->HasAnyFlags(RF_Standalone | RF_Public));
+
+			const TWeakObjectPtr<UPackage> Package = World->GetOutermost();
+			DestroyWorld(World);
+			TestFalse(TEXT("Package is valid"), IsValid(Package.Get()));
+		});
+	});
+
+	Describe("World snapshots", [this]() {
+		It("Restore actors to how they were captured", [this]() {
+			UWorld* const World = CreateWorld();
+			AActor* const Actor = World->SpawnActor<AActor>();
+
+			Automatron::Spec::FWorldSnapshot Snapshot;
+			Snapshot.Capture(World);
+
+			AActor* const Spawned = World->SpawnActor<AActor>();
+			Actor->Tags.Add(TEXT("Mutated"));
+			Actor->SetOwner(Spawned);
+
+			TestTrue(TEXT("Restored"), Snapshot.Restore());
+			TestEqual(TEXT("Tags"), Actor->Tags.Num(), 0);
+			TestNull(TEXT("Owner"), Actor->GetOwner());
+			TestFalse(TEXT("Spawned actor is valid"), IsValid(Spawned));
+
+			DestroyWorld(World);
+		});
+	});
+
+	Describe("Test manifest", [this]() {
+		It("Lists the tests another instance saved", [this]() {
+			using FManifest = Automatron::Spec::FManifest;
+
+			const FString Directory = FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("Manifest"));
+			IFileManager::Get().DeleteDirectory(*Directory, false, true);
+
+			const Automatron::Spec::FSpecInfo Info{TEXT("FManifestSpec"), TEXT("Automatron.Manifest"),
+				__FILE__, __LINE__, GetTestFlags(), AUTOMATRON_MODULE_NAME};
+			{
+				FManifest Manifest{Directory};
+				TArray<FManifest::FTest> Tests{{TEXT("Id"), TEXT("Description"), TEXT("File"), 7}};
+				Manifest.AddTests(Info, &Tests);
+				Manifest.Save();
+			}
+
+			FManifest Manifest{Directory};
+			TArray<FManifest::FTest> Tests;
+			bool bCacheable = false;
+			if (!TestTrue(TEXT("Found tests"), Manifest.FindTests(Info, Tests, bCacheable)) ||
+				!TestEqual(TEXT("Num tests"), Tests.Num(), 1))
+			{
+				return;
+			}
+			TestTrue(TEXT("Cacheable"), bCacheable);
+			TestEqual(TEXT("Id"), Tests[0].Id, FString{TEXT("Id")});
+			TestEqual(TEXT("Line"), Tests[0].LineNumber, 7);
+		});
+	});
+
+	Describe("World opt-in", [this]() {
+		UseWorld();
+
+		It("Gets a world", [this]() {
+			TestNotNull(TEXT("World"), GetMainWorld());
+		});
+	});
+}
+
+
+class FAutomatronVirtualTimeSpec : public Automatron::FTestSpec
+{
+	GENERATE_SPEC(FAutomatronVirtualTimeSpec, "Automatron.VirtualTime",
+		EAutomationTestFlags::EngineFilter |
+		EAutomationTestFlags::HighPriority |
+		EAutomationTestFlags::EditorContext);
+
+	FAutomatronVirtualTimeSpec()
+	{
+		bUseVirtualTime = true;
+		bCanUsePIEWorld = false;
+	}
+};
+
+void FAutomatronVirtualTimeSpec::Define()
+{
+	LatentIt("Waits for world timers without real time passing", FTimespan::FromSeconds(20),
+		[this](const FDoneDelegate& Done) {
+			const double StartTime = FPlatformTime::Seconds();
+			const FTimerDelegate OnTimer = FTimerDelegate::CreateLambda([this, Done, StartTime]() {
+				TestTrue(TEXT("Faster than real time"), FPlatformTime::Seconds() - StartTime < 5.0);
+				Done.Execute();
+			});
+
+			FTimerHandle Handle;
+			GetMainWorld()->GetTimerManager().SetTimer(Handle, OnTimer, 10.f, false);
+			WaitOnWorldTime();
+		});
+
+	LatentIt("Waits for other work in real time", [this](const FDoneDelegate& Done) {
+		const double StartTime = GetTime();
+		AsyncTask(ENamedThreads::AnyThread, [this, Done, StartTime]() {
+			FPlatformProcess::Sleep(0.1f);
+			AsyncTask(ENamedThreads::GameThread, [this, Done, StartTime]() {
+				TestEqual(TEXT("Virtual time"), GetTime(), StartTime);
+				Done.Execute();
+			});
+		});
+	});
 }
 
 #endif //WITH_DEV_AUTOMATION_TESTS
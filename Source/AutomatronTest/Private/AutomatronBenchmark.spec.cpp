@@ -0,0 +1,206 @@
+// Copyright 2020 Splash Damage, Ltd. - All Rights Reserved.
+
+#include <CoreMinimal.h>
+#include <Misc/AutomationTest.h>
+
+#include "Automatron.h"
+
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// Spec defining a flat list of It blocks, used to measure definition cost
+	class FDefinitionBenchmarkSpec : public Automatron::FTestSpecBase
+	{
+	public:
+		int32 NumTests = 0;
+
+		// Resolve the caller of each It, as blocks did before capturing locations at compile time
+		bool bWalkStack = false;
+
+		// @return seconds spent defining and baking the spec
+		double MeasureDefinition()
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			EnsureDefinitions();
+			return FPlatformTime::Seconds() - StartTime;
+		}
+
+		virtual uint32 GetTestFlags() const override
+		{
+			return EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter;
+		}
+
+	protected:
+		virtual FString GetBeautifiedTestName() const override
+		{
+			return TEXT("Automatron.Benchmarks.Definition");
+		}
+
+		virtual void Define() override
+		{
+			for (int32 Index = 0; Index < NumTests; ++Index)
+			{
+				if (bWalkStack)
+				{
+					FPlatformStackWalk::GetStack(1, 1);
+				}
+				It(FString::Printf(TEXT("Test %d"), Index), []() {});
+			}
+		}
+	};
+
+	// Spec constructed as many times as registered specs, used to measure startup cost
+	class FStartupBenchmarkSpec : public Automatron::FTestSpec
+	{
+	public:
+		FStartupBenchmarkSpec()
+		{
+			DefaultWorldSettings.bShouldTick = true;
+		}
+
+	protected:
+		virtual void Define() override {}
+	};
+
+	Automatron::FTestSpec* CreateStartupBenchmarkSpec()
+	{
+		return new FStartupBenchmarkSpec{};
+	}
+}	 // namespace
+
+
+class FAutomatronBenchmarkSpec : public Automatron::FTestSpec
+{
+	GENERATE_SPEC(FAutomatronBenchmarkSpec, "Automatron.Benchmarks",
+		EAutomationTestFlags::PerfFilter |
+		EAutomationTestFlags::LowPriority |
+		EAutomationTestFlags::EditorContext);
+
+	FAutomatronBenchmarkSpec()
+	{
+		bUseWorld = false;
+	}
+};
+
+void FAutomatronBenchmarkSpec::Define()
+{
+	It("Defines 10k It blocks", [this]() {
+		FDefinitionBenchmarkSpec StackWalkSpec;
+		StackWalkSpec.NumTests = 10000;
+		StackWalkSpec.bWalkStack = true;
+		const double StackWalkTime = StackWalkSpec.MeasureDefinition();
+
+		FDefinitionBenchmarkSpec CompileTimeSpec;
+		CompileTimeSpec.NumTests = 10000;
+		const double CompileTimeTime = CompileTimeSpec.MeasureDefinition();
+
+		TestEqual(TEXT("Defined tests"), CompileTimeSpec.GetNumTests(), 10000);
+		AddInfo(FString::Printf(TEXT("Defining 10k It blocks: %.2fms walking the stack, %.2fms with "
+									 "compile-time locations"),
+			StackWalkTime * 1000.0, CompileTimeTime * 1000.0));
+	});
+
+	It("Registers 2k specs", [this]() {
+		constexpr int32 NumSpecs = 2000;
+
+		double StartTime = FPlatformTime::Seconds();
+		{
+			TArray<TUniquePtr<FStartupBenchmarkSpec>> Specs;
+			for (int32 Index = 0; Index < NumSpecs; ++Index)
+			{
+				Specs.Add(MakeUnique<FStartupBenchmarkSpec>());
+			}
+		}
+		const double ConstructionTime = FPlatformTime::Seconds() - StartTime;
+
+		Automatron::Spec::FSpecInfo Info{
+			nullptr, TEXT("Automatron.Benchmarks.Startup"), __FILE__, __LINE__, GetTestFlags()};
+
+		// Entries register under their class name. Each needs its own to not unregister other tests
+		TArray<FString> ClassNames;
+		ClassNames.Reserve(NumSpecs);
+		for (int32 Index = 0; Index < NumSpecs; ++Index)
+		{
+			ClassNames.Add(FString::Printf(TEXT("FStartupBenchmarkSpec%d"), Index));
+		}
+
+		StartTime = FPlatformTime::Seconds();
+		{
+			TArray<TUniquePtr<Automatron::Spec::FLazySpec>> Entries;
+			for (int32 Index = 0; Index < NumSpecs; ++Index)
+			{
+				Info.ClassName = *ClassNames[Index];
+				Entries.Add(MakeUnique<Automatron::Spec::FLazySpec>(Info, &CreateStartupBenchmarkSpec));
+			}
+			TestFalse(TEXT("Spec constructed"), Entries[0]->IsSpecConstructed());
+		}
+		const double LazyTime = FPlatformTime::Seconds() - StartTime;
+
+		AddInfo(FString::Printf(
+			TEXT("Registering 2k specs: %.2fms constructing them, %.2fms with lazy entries"),
+			ConstructionTime * 1000.0, LazyTime * 1000.0));
+	});
+
+	It("Creates worlds of each profile", [this]() {
+		constexpr int32 NumWorlds = 10;
+
+		const auto Measure = [this](Automatron::ETestWorldProfile Profile, const TCHAR* ProfileName) {
+			Automatron::FTestWorldSettings Settings;
+			Settings.Profile = Profile;
+
+			double CreateTime = 0.0;
+			double DestroyTime = 0.0;
+			int64 UsedMemory = 0;
+			for (int32 Index = 0; Index < NumWorlds; ++Index)
+			{
+				const int64 MemoryBefore = FPlatformMemory::GetStats().UsedPhysical;
+				double StartTime = FPlatformTime::Seconds();
+				UWorld* World = CreateWorld(Settings);
+				CreateTime += FPlatformTime::Seconds() - StartTime;
+				UsedMemory += int64(FPlatformMemory::GetStats().UsedPhysical) - MemoryBefore;
+
+				StartTime = FPlatformTime::Seconds();
+				TestTrue(TEXT("World destroyed"), DestroyWorld(World));
+				DestroyTime += FPlatformTime::Seconds() - StartTime;
+			}
+
+			AddInfo(FString::Printf(TEXT("%s world: %.2fms to create, %.2fms to destroy, %.2fMB used"),
+				ProfileName, CreateTime * 1000.0 / NumWorlds, DestroyTime * 1000.0 / NumWorlds,
+				UsedMemory / (1024.0 * 1024.0 * NumWorlds)));
+		};
+
+		Measure(Automatron::ETestWorldProfile::Full, TEXT("Full"));
+		Measure(Automatron::ETestWorldProfile::LogicOnly, TEXT("Logic only"));
+	});
+
+	It("Runs 1k async blocks", [this]() {
+		constexpr int32 NumBlocks = 1000;
+
+		const auto Measure = [](Automatron::Spec::FAsyncExecution Execution) {
+			const double StartTime = FPlatformTime::Seconds();
+			TArray<TFuture<void>> Futures;
+			for (int32 Index = 0; Index < NumBlocks; ++Index)
+			{
+				Futures.Add(Execution.Launch([]() {}));
+			}
+			for (const TFuture<void>& Future : Futures)
+			{
+				Future.Wait();
+			}
+			return FPlatformTime::Seconds() - StartTime;
+		};
+
+		const double ThreadPoolTime = Measure(EAsyncExecution::ThreadPool);
+		const double WorkerPoolTime = Measure(WorkerPool());
+
+		AddInfo(FString::Printf(
+			TEXT("Running 1k async blocks: %.2fms on the thread pool, %.2fms on the worker pool waiting "
+				 "%.3fms on average to start"),
+			ThreadPoolTime * 1000.0, WorkerPoolTime * 1000.0,
+			Automatron::Spec::FWorkerPool::Get().GetAverageWaitTime() * 1000.0));
+	});
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS